@@ -0,0 +1,116 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief The crypto operations the plugin needs from an OpenPGP engine:
+ * listing keys, looking up keys, encrypting and decrypting.
+ * GPGMeWrapper implements it with gpgme, tests/GPGFakeBackend with made up
+ * in-memory keys, so the toolview can be exercised without a keyring.
+ * Keys are only passed around as GPGKeyDetails and fingerprints, no
+ * gpgme types are part of this interface.
+ */
+
+#include <GPGKeyDetails.hpp>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct GPGOperationResult {
+  QString resultString;  // de- or encrypted string depending on operation
+  bool keyFound = false;
+  bool decryptionSuccess = false;
+  QString errorMessage;
+  QString keyIDUsedForDecryption;
+  QString fingerprintUsedForDecryption;  // empty if the key is not loaded
+  // signature details, only set by signAndEncrypt() and decryptAndVerify()
+  bool signatureFound = false;  // the message is signed
+  bool signatureValid = false;  // all signatures are good
+  QString signerFingerprint;    // fingerprint of the (first) signing key
+  QString signatureSummary;     // one human readable line per signature
+};
+
+// The result of one full keylisting (see GPGBackend::listKeySnapshot())
+struct GPGKeyListing {
+  QVector<GPGKeyDetails> details;    // all public keys
+  QSet<QString> secretFingerprints;  // the keys with a private key
+};
+
+class GPGBackend {
+public:
+  virtual ~GPGBackend() {}
+
+  /**
+   * @brief Lists all keys. This is called on a worker thread (see
+   *        GPGKeyLoader), so it must not touch any backend state that is
+   *        not guarded by a mutex.
+   */
+  virtual GPGKeyListing listKeySnapshot() = 0;
+
+  /**
+   * @brief Looks up several keys at once.
+   * @param patterns_ Fingerprints, key IDs, "<mail addresses>" or parts
+   *                  of a user ID.
+   * @return The fingerprints of the matching keys, one list per pattern.
+   */
+  virtual QVector<QStringList>
+  lookupKeyFingerprints(const QStringList &patterns_) = 0;
+
+  /**
+   * @brief Encrypts a string to a single recipient or symmetrically.
+   * @param fingerprint_ The fingerprint of the recipient key.
+   * @param recipientMail_ The key must have a user ID with this address
+   *                       unless it is empty.
+   * @return The GPGOperationResult (see above)
+   */
+  virtual const GPGOperationResult
+  encryptString(const QString &inputString_, const QString &fingerprint_,
+                const QString &recipientMail_,
+                bool symmetricEncryption_ = false) = 0;
+
+  /**
+   * @brief Encrypts a string to the given keys in one message.
+   * @return The GPGOperationResult (see above)
+   */
+  virtual const GPGOperationResult
+  encryptStringToRecipients(const QString &inputString_,
+                            const QStringList &fingerprints_) = 0;
+
+  /**
+   * @brief Signs with the default key and encrypts in one pass.
+   * @return The GPGOperationResult (see above) with the signature details.
+   */
+  virtual const GPGOperationResult
+  signAndEncrypt(const QString &inputString_, const QStringList &fingerprints_,
+                 bool symmetricEncryption_ = false) = 0;
+
+  /**
+   * @brief Decrypts a string with any of the available private keys.
+   * @return The GPGOperationResult (see above)
+   */
+  virtual const GPGOperationResult
+  decryptString(const QString &inputString_) = 0;
+
+  /**
+   * @brief Like decryptString(), but also verifies the signatures.
+   * @return The GPGOperationResult (see above) with the signature details.
+   */
+  virtual const GPGOperationResult
+  decryptAndVerify(const QString &inputString_) = 0;
+};
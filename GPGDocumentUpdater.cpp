@@ -0,0 +1,207 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGDocumentUpdater.hpp>
+#include <KTextEditor/Cursor>
+#include <KTextEditor/Range>
+#include <QHash>
+#include <QVector>
+#include <algorithm>
+
+/// local functions
+namespace {
+
+// old lines [oldBegin, oldEnd) become new lines [newBegin, newEnd)
+struct Hunk {
+  int oldBegin;
+  int oldEnd;
+  int newBegin;
+  int newEnd;
+};
+
+// A line that occurs once in the old and once in the new range
+struct Anchor {
+  int oldLine = -1;
+  int newLine = -1;
+  int numOld = 0;
+  int numNew = 0;
+};
+
+// the longest run of anchors whose old lines increase with the new ones
+QVector<Anchor> increasingAnchors(const QVector<Anchor> &anchors_) {
+  // patience sorting: tails.at(k) ends the best run of length k + 1
+  QVector<int> tails;
+  QVector<int> previous(anchors_.size(), -1);
+  for (auto i = 0; i < anchors_.size(); ++i) {
+    auto it = std::lower_bound(tails.begin(), tails.end(), i,
+                               [&anchors_](int a_, int b_) {
+                                 return anchors_.at(a_).oldLine <
+                                        anchors_.at(b_).oldLine;
+                               });
+    if (it != tails.begin()) {
+      previous[i] = *(it - 1);
+    }
+    if (it == tails.end()) {
+      tails.append(i);
+    } else {
+      *it = i;
+    }
+  }
+  QVector<Anchor> run;
+  int i = tails.isEmpty() ? -1 : tails.last();
+  for (; i >= 0; i = previous.at(i)) {
+    run.prepend(anchors_.at(i));
+  }
+  return run;
+}
+
+} // namespace
+
+/// class functions
+int GPGDocumentUpdater::replaceText(KTextEditor::Document *document_,
+                                    const QString &newText_) {
+  const int oldLines = document_->lines();
+  // a document always has at least one (maybe empty) line, just like
+  // newText_.split('\n') does
+  const QVector<QStringRef> newLines = newText_.splitRef(QLatin1Char('\n'));
+  const int commonLines = qMin(oldLines, newLines.size());
+
+  // skip the unchanged lines at the top...
+  int prefix = 0;
+  while (prefix < commonLines &&
+         document_->line(prefix) == newLines.at(prefix)) {
+    ++prefix;
+  }
+  // ...and at the bottom
+  int suffix = 0;
+  while (suffix < commonLines - prefix &&
+         document_->line(oldLines - 1 - suffix) ==
+             newLines.at(newLines.size() - 1 - suffix)) {
+    ++suffix;
+  }
+  if (prefix == oldLines && prefix == newLines.size()) {
+    return 0;
+  }
+
+  // Between them, lines that occur exactly once on both sides and in the
+  // same order stay (patience diff). Only the ranges around them change,
+  // so two edits far apart do not replace everything in between.
+  const int oldEnd = oldLines - suffix;
+  const int newEnd = newLines.size() - suffix;
+  QVector<QString> oldMiddle;
+  oldMiddle.reserve(oldEnd - prefix);
+  QHash<QStringRef, Anchor> anchorByLine;
+  for (auto line = prefix; line < oldEnd; ++line) {
+    oldMiddle.append(document_->line(line));
+  }
+  for (auto line = prefix; line < oldEnd; ++line) {
+    Anchor &anchor = anchorByLine[QStringRef(&oldMiddle.at(line - prefix))];
+    anchor.oldLine = line;
+    ++anchor.numOld;
+  }
+  for (auto line = prefix; line < newEnd; ++line) {
+    auto it = anchorByLine.find(newLines.at(line));
+    if (it != anchorByLine.end()) {
+      it->newLine = line;
+      ++it->numNew;
+    }
+  }
+  QVector<Anchor> anchors;
+  for (auto line = prefix; line < newEnd; ++line) {
+    const Anchor anchor = anchorByLine.value(newLines.at(line));
+    if (anchor.numOld == 1 && anchor.numNew == 1) {
+      anchors.append(anchor);
+    }
+  }
+  anchors = increasingAnchors(anchors);
+  // the end of the changed ranges is an anchor too
+  Anchor end;
+  end.oldLine = oldEnd;
+  end.newLine = newEnd;
+  anchors.append(end);
+
+  QVector<Hunk> hunks;
+  int oldLine = prefix;
+  int newLine = prefix;
+  for (auto &anchor : anchors) {
+    Hunk hunk{oldLine, anchor.oldLine, newLine, anchor.newLine};
+    // anchors are rare in changed text, trim what matches next to them
+    while (hunk.oldBegin < hunk.oldEnd && hunk.newBegin < hunk.newEnd &&
+           oldMiddle.at(hunk.oldBegin - prefix) ==
+               newLines.at(hunk.newBegin)) {
+      ++hunk.oldBegin;
+      ++hunk.newBegin;
+    }
+    while (hunk.oldBegin < hunk.oldEnd && hunk.newBegin < hunk.newEnd &&
+           oldMiddle.at(hunk.oldEnd - 1 - prefix) ==
+               newLines.at(hunk.newEnd - 1)) {
+      --hunk.oldEnd;
+      --hunk.newEnd;
+    }
+    if (hunk.oldBegin < hunk.oldEnd || hunk.newBegin < hunk.newEnd) {
+      hunks.append(hunk);
+    }
+    oldLine = anchor.oldLine + 1;
+    newLine = anchor.newLine + 1;
+  }
+
+  int numChangedLines = 0;
+  KTextEditor::Document::EditingTransaction transaction(document_);
+  // bottom up, so the line numbers of the hunks above stay valid
+  for (auto h = hunks.size() - 1; h >= 0; --h) {
+    const Hunk &hunk = hunks.at(h);
+    const int changedOldLines = hunk.oldEnd - hunk.oldBegin;
+    const int changedNewLines = hunk.newEnd - hunk.newBegin;
+    numChangedLines += qMax(changedOldLines, changedNewLines);
+    const int documentLines = document_->lines();
+    QString lines;
+    if (changedNewLines > 0) {
+      const QStringRef &first = newLines.at(hunk.newBegin);
+      const QStringRef &last = newLines.at(hunk.newEnd - 1);
+      lines = newText_.mid(first.position(),
+                           last.position() + last.size() - first.position());
+    }
+    if (changedOldLines > 0 && changedNewLines > 0) {
+      const KTextEditor::Range range(
+          KTextEditor::Cursor(hunk.oldBegin, 0),
+          KTextEditor::Cursor(hunk.oldEnd - 1,
+                              document_->lineLength(hunk.oldEnd - 1)));
+      document_->replaceText(range, lines);
+    } else if (changedNewLines > 0) {
+      if (hunk.oldBegin < documentLines) {
+        document_->insertText(KTextEditor::Cursor(hunk.oldBegin, 0),
+                              lines + QLatin1Char('\n'));
+      } else {
+        document_->insertText(
+            KTextEditor::Cursor(documentLines - 1,
+                                document_->lineLength(documentLines - 1)),
+            QLatin1Char('\n') + lines);
+      }
+    } else if (hunk.oldEnd < documentLines) {
+      document_->removeText(
+          KTextEditor::Range(KTextEditor::Cursor(hunk.oldBegin, 0),
+                             KTextEditor::Cursor(hunk.oldEnd, 0)));
+    } else {
+      document_->removeText(KTextEditor::Range(
+          KTextEditor::Cursor(hunk.oldBegin - 1,
+                              document_->lineLength(hunk.oldBegin - 1)),
+          KTextEditor::Cursor(documentLines - 1,
+                              document_->lineLength(documentLines - 1))));
+    }
+  }
+  return numChangedLines;
+}
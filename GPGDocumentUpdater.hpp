@@ -0,0 +1,41 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Replaces the text of a KTextEditor::Document by only touching
+ * the lines that actually changed. Unchanged lines (found by a patience
+ * diff) keep their highlighting state, marks and cursors, and the whole
+ * replacement is a single undo step.
+ */
+
+#include <KTextEditor/Document>
+#include <QString>
+
+class GPGDocumentUpdater {
+public:
+  /**
+   * @brief Makes the document text equal to newText_.
+   * @param document_ The document to change.
+   * @param newText_ The new document text.
+   * @return The number of lines that were replaced, inserted or removed,
+   *         summed over all changed ranges.
+   */
+  static int replaceText(KTextEditor::Document *document_,
+                         const QString &newText_);
+};
@@ -0,0 +1,230 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGEncryptedSearch.hpp>
+#include <GPGEngineStats.hpp>
+#include <GPGPacketParser.hpp>
+#include <QDirIterator>
+#include <QFile>
+#include <QStringList>
+#include <QThread>
+#include <gpgme++/context.h>
+#include <gpgme++/data.h>
+#include <gpgme++/decryptionresult.h>
+#include <memory>
+#include <string>
+
+/// local functions
+namespace {
+
+// wipes a decrypted text on every way out of searchFile()
+class PlaintextWiper {
+public:
+  explicit PlaintextWiper(QString &plaintext_) : m_plaintext(plaintext_) {}
+  ~PlaintextWiper() {
+    if (!m_plaintext.isEmpty()) {
+      m_plaintext.detach();
+      GPGPlaintextCache::secureZero(m_plaintext.data(),
+                                    m_plaintext.size() * sizeof(QChar));
+    }
+  }
+
+  PlaintextWiper(const PlaintextWiper &) = delete;
+  PlaintextWiper &operator=(const PlaintextWiper &) = delete;
+
+private:
+  QString &m_plaintext;
+};
+
+} // namespace
+
+/// class functions
+GPGEncryptedSearch::GPGEncryptedSearch(QObject *parent_) : QObject(parent_) {
+  // every decryption is a gpg process, so a few at a time are plenty
+  m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), 4));
+}
+
+GPGEncryptedSearch::~GPGEncryptedSearch() {
+  cancel();
+  m_pool.waitForDone();
+}
+
+bool GPGEncryptedSearch::isRunning() const {
+  return m_remaining.loadRelaxed() > 0;
+}
+
+void GPGEncryptedSearch::cancel() { m_canceled.storeRelaxed(1); }
+
+int GPGEncryptedSearch::search(const QString &folder_, const QString &pattern_,
+                               bool isRegularExpression_, bool caseSensitive_,
+                               GPGPlaintextCache *plaintextCache_,
+                               GPGPassphraseProvider *passphraseProvider_) {
+  if (isRunning() || pattern_.isEmpty()) {
+    return -1;
+  }
+  m_isRegularExpression = isRegularExpression_;
+  if (m_isRegularExpression) {
+    m_regularExpression.setPattern(pattern_);
+    m_regularExpression.setPatternOptions(
+        QRegularExpression::MultilineOption |
+        (caseSensitive_ ? QRegularExpression::NoPatternOption
+                        : QRegularExpression::CaseInsensitiveOption));
+    if (!m_regularExpression.isValid()) {
+      return -1;
+    }
+    m_regularExpression.optimize();
+  } else {
+    m_literalMatcher.setPattern(pattern_);
+    m_literalMatcher.setCaseSensitivity(caseSensitive_ ? Qt::CaseSensitive
+                                                       : Qt::CaseInsensitive);
+  }
+  m_plaintextCache = plaintextCache_;
+  m_passphraseProvider = passphraseProvider_;
+
+  QStringList files;
+  QDirIterator it(folder_, QStringList() << "*.gpg" << "*.pgp" << "*.asc",
+                  QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    files.append(it.next());
+  }
+  m_numFiles = files.size();
+  m_remaining.storeRelaxed(files.size());
+  m_numMatches.storeRelaxed(0);
+  m_numFailed.storeRelaxed(0);
+  m_canceled.storeRelaxed(0);
+  if (files.isEmpty()) {
+    emit finished(0, 0, 0);
+    return 0;
+  }
+  GpgME::initializeLibrary();
+  const GPGEngineStats::Action action = GPGEngineStats::currentAction();
+  for (auto &file : files) {
+    m_pool.start([this, file, action]() {
+      GPGEngineStats::ActionScope scope(action);
+      searchFile(file);
+    });
+  }
+  return files.size();
+}
+
+void GPGEncryptedSearch::searchFile(const QString &file_) {
+  if (m_canceled.loadRelaxed()) {
+    fileDone();
+    return;
+  }
+  QFile file(file_);
+  if (!file.open(QIODevice::ReadOnly)) {
+    m_numFailed.ref();
+    emit fileFailed(file_, file.errorString());
+    fileDone();
+    return;
+  }
+  const QByteArray ciphertext = file.readAll();
+  file.close();
+  // .asc files are often signatures or keys, skip everything that is
+  // not an encrypted message without starting gpg
+  if (!GPGPacketParser::parseMessageHeader(
+           ciphertext.left(GPGPacketParser::maxHeaderScanSize))
+           .isEncrypted) {
+    fileDone();
+    return;
+  }
+
+  QByteArray ciphertextHash;
+  QString plaintext;
+  const PlaintextWiper wiper(plaintext);
+  QString keyID;
+  if (m_plaintextCache && m_plaintextCache->isEnabled()) {
+    ciphertextHash = GPGPlaintextCache::hashCiphertext(ciphertext);
+    if (m_plaintextCache->lookup(ciphertextHash, plaintext, keyID)) {
+      m_numMatches.fetchAndAddRelaxed(matchText(file_, plaintext));
+      fileDone();
+      return;
+    }
+  }
+
+  auto ctx = std::unique_ptr<GpgME::Context>(
+      GpgME::Context::createForProtocol(GpgME::OpenPGP));
+  if (m_passphraseProvider) {
+    m_passphraseProvider->attachTo(ctx.get());
+  }
+  // decrypt into gpgme's memory buffer, nothing is written to disk
+  GpgME::Data encrypted(ciphertext.constData(), ciphertext.size(), false);
+  GpgME::Data decrypted;
+  GPGEngineStats::record(GPGEngineOp::Decrypt);
+  const GpgME::DecryptionResult result = ctx->decrypt(encrypted, decrypted);
+  if (result.error()) {
+    m_numFailed.ref();
+    emit fileFailed(file_, QString(result.error().asString()));
+    fileDone();
+    return;
+  }
+  std::string plainBytes = decrypted.toString();
+  plaintext = QString::fromUtf8(plainBytes.data(), int(plainBytes.size()));
+  GPGPlaintextCache::secureZero(&plainBytes[0], plainBytes.size());
+
+  m_numMatches.fetchAndAddRelaxed(matchText(file_, plaintext));
+  if (m_plaintextCache && m_plaintextCache->isEnabled()) {
+    m_plaintextCache->insert(ciphertextHash, plaintext);
+  }
+  fileDone();
+}
+
+int GPGEncryptedSearch::matchText(const QString &file_,
+                                  const QString &plaintext_) {
+  int numMatches = 0;
+  int line = 0;      // line number of lineStart
+  int lineStart = 0; // start of the line that was counted up to
+  int pos = 0;
+  while (pos < plaintext_.size()) {
+    int matchPos = -1;
+    if (m_isRegularExpression) {
+      const QRegularExpressionMatch match =
+          m_regularExpression.match(plaintext_, pos);
+      matchPos = match.hasMatch() ? match.capturedStart() : -1;
+    } else {
+      matchPos = m_literalMatcher.indexIn(plaintext_, pos);
+    }
+    if (matchPos < 0) {
+      break;
+    }
+    // count the lines between the last match and this one
+    for (int i = lineStart; i < matchPos; ++i) {
+      if (plaintext_.at(i) == QLatin1Char('\n')) {
+        ++line;
+        lineStart = i + 1;
+      }
+    }
+    int lineEnd = plaintext_.indexOf(QLatin1Char('\n'), matchPos);
+    if (lineEnd < 0) {
+      lineEnd = plaintext_.size();
+    }
+    emit matchFound(file_, line + 1,
+                    plaintext_.mid(lineStart, lineEnd - lineStart));
+    ++numMatches;
+    // report every line only once
+    pos = lineEnd + 1;
+  }
+  return numMatches;
+}
+
+void GPGEncryptedSearch::fileDone() {
+  if (!m_remaining.deref()) {
+    emit finished(m_numFiles, m_numMatches.loadRelaxed(),
+                  m_numFailed.loadRelaxed());
+  }
+}
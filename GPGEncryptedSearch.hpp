@@ -0,0 +1,94 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Searches the content of all encrypted files (.gpg/.pgp/.asc) in
+ * a folder tree. Files are decrypted in parallel on a bounded pool of
+ * worker threads, the plaintext only ever lives in memory and is wiped
+ * after matching. Matches are reported as soon as a file is done.
+ * If a GPGPlaintextCache is enabled, it is asked first and filled with
+ * the decrypted files.
+ */
+
+#include <GPGPassphraseProvider.hpp>
+#include <GPGPlaintextCache.hpp>
+#include <QAtomicInt>
+#include <QObject>
+#include <QRegularExpression>
+#include <QString>
+#include <QStringMatcher>
+#include <QThreadPool>
+
+class GPGEncryptedSearch : public QObject {
+  Q_OBJECT
+
+public:
+  explicit GPGEncryptedSearch(QObject *parent_ = nullptr);
+
+  ~GPGEncryptedSearch();
+
+  /**
+   * @brief Starts searching all encrypted files below folder_.
+   *        Returns immediately, results are reported by the signals below.
+   * @param folder_ The folder to walk (including sub folders).
+   * @param pattern_ The search text or regular expression.
+   * @param isRegularExpression_ Treat pattern_ as a regular expression.
+   * @param caseSensitive_ Match case.
+   * @param plaintextCache_ An optional cache for decrypted text.
+   * @param passphraseProvider_ Asks for passphrases instead of pinentry
+   *        (optional, see GPGPassphraseProvider).
+   * @return The number of files that will be searched, or -1 if a search
+   *         is still running or the pattern is invalid.
+   */
+  int search(const QString &folder_, const QString &pattern_,
+             bool isRegularExpression_, bool caseSensitive_,
+             GPGPlaintextCache *plaintextCache_ = nullptr,
+             GPGPassphraseProvider *passphraseProvider_ = nullptr);
+
+  bool isRunning() const;
+
+  // stops handing out new files, running decryptions are finished
+  void cancel();
+
+signals:
+  void matchFound(const QString &file, int line, const QString &lineText);
+  void fileFailed(const QString &file, const QString &errorMessage);
+  void finished(int numFiles, int numMatches, int numFailed);
+
+private:
+  QThreadPool m_pool;
+  GPGPlaintextCache *m_plaintextCache = nullptr;
+  GPGPassphraseProvider *m_passphraseProvider = nullptr;
+  QStringMatcher m_literalMatcher;
+  QRegularExpression m_regularExpression;
+  bool m_isRegularExpression = false;
+
+  QAtomicInt m_remaining;
+  QAtomicInt m_numMatches;
+  QAtomicInt m_numFailed;
+  QAtomicInt m_canceled;
+  int m_numFiles = 0;
+
+  void searchFile(const QString &file_);
+
+  // reports every line of plaintext_ that matches, returns the count
+  int matchText(const QString &file_, const QString &plaintext_);
+
+  void fileDone();
+};
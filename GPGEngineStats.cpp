@@ -0,0 +1,127 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGEngineStats.hpp>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <algorithm>
+
+struct GPGEngineStats::ActionRun {
+  QString name;
+  int budget = -1;
+  int numOps = 0; // on all threads, guarded by statsMutex
+  Action parent; // the enclosing run on the thread that started this one
+};
+
+/// local functions
+namespace {
+
+QMutex statsMutex;
+QHash<QString, GPGEngineOpCounts> statsCounts;
+int statsNumBudgetViolations = 0;
+
+// per thread, so worker threads never pick up the UI thread's action
+thread_local GPGEngineStats::Action threadAction;
+
+} // namespace
+
+/// class functions
+int GPGEngineOpCounts::total() const {
+  int sum = 0;
+  for (auto i = 0; i < numOps; ++i) {
+    sum += ops[i];
+  }
+  return sum;
+}
+
+GPGEngineStats::ActionScope::ActionScope(const QString &action_, int budget_)
+    : m_previousAction(threadAction) {
+  threadAction = newAction(action_, budget_);
+  threadAction->parent = m_previousAction;
+}
+
+GPGEngineStats::ActionScope::ActionScope(const Action &action_)
+    : m_previousAction(threadAction) {
+  threadAction = action_;
+}
+
+GPGEngineStats::ActionScope::~ActionScope() { threadAction = m_previousAction; }
+
+void GPGEngineStats::record(GPGEngineOp op_) {
+  QMutexLocker locker(&statsMutex);
+  ++statsCounts[threadAction ? threadAction->name : QString()].ops[int(op_)];
+  // a nested run's operations also count for the enclosing runs
+  for (ActionRun *run = threadAction.get(); run; run = run->parent.get()) {
+    // warn once per run, whichever thread goes over the budget
+    if (++run->numOps == run->budget + 1 && run->budget >= 0) {
+      ++statsNumBudgetViolations;
+      qWarning("kate-gpg-plugin: \"%s\" ran more than %d gpg operations",
+               qPrintable(run->name), run->budget);
+    }
+  }
+}
+
+GPGEngineStats::Action GPGEngineStats::currentAction() { return threadAction; }
+
+GPGEngineStats::Action GPGEngineStats::newAction(const QString &action_,
+                                                 int budget_) {
+  auto run = std::make_shared<ActionRun>();
+  run->name = action_;
+  run->budget = budget_;
+  return run;
+}
+
+GPGEngineOpCounts GPGEngineStats::counts(const QString &action_) {
+  QMutexLocker locker(&statsMutex);
+  return statsCounts.value(action_);
+}
+
+QHash<QString, GPGEngineOpCounts> GPGEngineStats::allCounts() {
+  QMutexLocker locker(&statsMutex);
+  return statsCounts;
+}
+
+int GPGEngineStats::numBudgetViolations() {
+  QMutexLocker locker(&statsMutex);
+  return statsNumBudgetViolations;
+}
+
+void GPGEngineStats::reset() {
+  QMutexLocker locker(&statsMutex);
+  statsCounts.clear();
+  statsNumBudgetViolations = 0;
+}
+
+QString GPGEngineStats::summary() {
+  const QHash<QString, GPGEngineOpCounts> all = allCounts();
+  QStringList actions = all.keys();
+  std::sort(actions.begin(), actions.end());
+  QStringList lines;
+  for (auto &action : actions) {
+    const GPGEngineOpCounts &c = all[action];
+    lines << QString("%1: %2 listings, %3 lookups, %4 encrypt, %5 decrypt, "
+                     "%6 verify")
+                 .arg(action.isEmpty() ? QString("(no action)") : action)
+                 .arg(c.count(GPGEngineOp::KeyListing))
+                 .arg(c.count(GPGEngineOp::KeyLookup))
+                 .arg(c.count(GPGEngineOp::Encrypt))
+                 .arg(c.count(GPGEngineOp::Decrypt))
+                 .arg(c.count(GPGEngineOp::Verify));
+  }
+  return lines.join('\n');
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Counts the round trips to the gpg engine, grouped by the UI
+ * action that caused them. Every gpg operation costs at least one
+ * gpg-agent/gpg process round trip, so a handler that is supposed to work
+ * on the loaded keys only (e.g. a selection change) must not show up here.
+ *
+ * A UI handler opens an ActionScope. Operations on the same thread are
+ * counted for that action until the scope ends. Work handed to a worker
+ * thread takes currentAction() along and opens a scope for it there, so
+ * its operations count for the same run of the action and its budget,
+ * even after the handler has returned.
+ */
+
+#include <QHash>
+#include <QString>
+#include <memory>
+
+enum class GPGEngineOp { KeyListing, KeyLookup, Encrypt, Decrypt, Verify };
+
+struct GPGEngineOpCounts {
+  static const int numOps = 5;
+  int ops[numOps] = {0, 0, 0, 0, 0};
+
+  int count(GPGEngineOp op_) const { return ops[int(op_)]; }
+  int total() const;
+};
+
+class GPGEngineStats {
+public:
+  struct ActionRun; // one run of an action, see GPGEngineStats.cpp
+  using Action = std::shared_ptr<ActionRun>;
+
+  class ActionScope {
+  public:
+    /**
+     * @brief Starts a run of an action. A run inside another one also
+     *        counts for the enclosing run.
+     * @param action_ Name of the UI action, e.g. "select key".
+     * @param budget_ Maximum number of engine operations one run may
+     *                cause on any thread, -1 = unlimited. Going over
+     *                budget prints a warning and counts as a budget
+     *                violation.
+     */
+    explicit ActionScope(const QString &action_, int budget_ = -1);
+
+    // continues a run, e.g. currentAction() on a worker thread or a
+    // newAction()
+    explicit ActionScope(const Action &action_);
+
+    ~ActionScope();
+
+    ActionScope(const ActionScope &) = delete;
+    ActionScope &operator=(const ActionScope &) = delete;
+
+  private:
+    Action m_previousAction;
+  };
+
+  // counts one operation for the current action run of this thread
+  static void record(GPGEngineOp op_);
+
+  // the action run of this thread, nullptr outside of any ActionScope
+  static Action currentAction();
+
+  // a run that does not count for the current one, for work an action
+  // only starts, see ActionScope(const Action &)
+  static Action newAction(const QString &action_, int budget_ = -1);
+
+  static GPGEngineOpCounts counts(const QString &action_);
+  static QHash<QString, GPGEngineOpCounts> allCounts();
+  static int numBudgetViolations();
+
+  static void reset();
+
+  // one line per action, e.g. "select key: 0 listings, 0 lookups, ..."
+  static QString summary();
+};
@@ -0,0 +1,86 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGEntropyEstimator.hpp>
+#include <cmath>
+#include <cstdint>
+
+/// local functions
+namespace {
+
+const int sampleBlockSize = 4096;
+
+// Counting into four interleaved histograms avoids the store-to-load
+// dependency between neighbouring equal bytes (which are common in text)
+// and lets the compiler unroll and pipeline the loop.
+void countBytes(const unsigned char *data_, int size_,
+                uint32_t histograms_[4][256]) {
+  int i = 0;
+  for (; i + 4 <= size_; i += 4) {
+    ++histograms_[0][data_[i]];
+    ++histograms_[1][data_[i + 1]];
+    ++histograms_[2][data_[i + 2]];
+    ++histograms_[3][data_[i + 3]];
+  }
+  for (; i < size_; ++i) {
+    ++histograms_[0][data_[i]];
+  }
+}
+
+} // namespace
+
+/// class functions
+double GPGEntropyEstimator::estimateBitsPerByte(const QByteArray &data_,
+                                                int sampleSize_) {
+  if (data_.isEmpty() || sampleSize_ <= 0) {
+    return 0.0;
+  }
+  uint32_t histograms[4][256] = {};
+  const unsigned char *data =
+      reinterpret_cast<const unsigned char *>(data_.constData());
+  int counted = 0;
+  if (data_.size() <= sampleSize_) {
+    countBytes(data, data_.size(), histograms);
+    counted = data_.size();
+  } else {
+    // spread the sample blocks over the whole input, so a compressible
+    // header in front of a large blob does not decide for all of it
+    const int blockSize = qMin(sampleBlockSize, sampleSize_);
+    const int numBlocks = qMax(1, sampleSize_ / blockSize);
+    const qint64 lastOffset = qMax<qint64>(0, data_.size() - blockSize);
+    const qint64 stride = lastOffset / qMax(1, numBlocks - 1);
+    for (int b = 0; b < numBlocks; ++b) {
+      const qint64 offset = qMin<qint64>(b * stride, lastOffset);
+      countBytes(data + offset, blockSize, histograms);
+      counted += blockSize;
+    }
+  }
+  double entropy = 0.0;
+  for (int c = 0; c < 256; ++c) {
+    const uint32_t count = histograms[0][c] + histograms[1][c] +
+                           histograms[2][c] + histograms[3][c];
+    if (count > 0) {
+      const double p = double(count) / counted;
+      entropy -= p * std::log2(p);
+    }
+  }
+  return entropy;
+}
+
+bool GPGEntropyEstimator::looksIncompressible(const QByteArray &data_) {
+  return estimateBitsPerByte(data_) >= incompressibleBitsPerByte;
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief A fast byte entropy estimate over a sample of a text. It is used
+ * to skip gpg's compression for content that would not get any smaller,
+ * like base64 blobs or random looking data.
+ */
+
+#include <QByteArray>
+
+class GPGEntropyEstimator {
+public:
+  // Base64 has 6 bits of entropy per byte, natural language text and
+  // source code usually stay below 5.
+  static constexpr double incompressibleBitsPerByte = 5.8;
+
+  static const int defaultSampleSize = 64 * 1024;
+
+  /**
+   * @brief Estimates the order-0 (Shannon) entropy of data_. Large inputs
+   *        are sampled in blocks spread evenly over the whole input.
+   * @param data_ The data.
+   * @param sampleSize_ The maximum number of bytes to look at.
+   * @return The entropy in bits per byte (0..8).
+   */
+  static double estimateBitsPerByte(const QByteArray &data_,
+                                    int sampleSize_ = defaultSampleSize);
+
+  // true if compressing data_ is most likely a waste of time
+  static bool looksIncompressible(const QByteArray &data_);
+};
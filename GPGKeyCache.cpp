@@ -0,0 +1,126 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGKeyCache.hpp>
+#include <QByteArray>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+/// local functions
+// "KGPC" in a hex editor
+const quint32 cacheMagic = 0x4b475043;
+
+/// class functions
+GPGKeyCache::GPGKeyCache() : m_fileName(defaultFileName()) {}
+
+QString GPGKeyCache::defaultFileName() {
+  return QStandardPaths::writableLocation(
+             QStandardPaths::GenericCacheLocation) +
+         QStringLiteral("/kate_gpg_plugin/keys.cache");
+}
+
+void GPGKeyCache::setFileName(const QString &fileName_) {
+  m_fileName = fileName_;
+}
+
+QString GPGKeyCache::fileName() const { return m_fileName; }
+
+GPGKeyCache::Status GPGKeyCache::load(const GPGKeyringStamp &stamp_,
+                                      QVector<GPGKeyDetails> &keys_) const {
+  QFile file(m_fileName);
+  if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+    return Status::Missing;
+  }
+  uchar *mapped = file.map(0, file.size());
+  if (!mapped) {
+    return Status::Missing;
+  }
+  // read straight from the mapping, only the strings are copied
+  const QByteArray data = QByteArray::fromRawData(
+      reinterpret_cast<const char *>(mapped), int(file.size()));
+  QDataStream in(data);
+  in.setVersion(QDataStream::Qt_5_15);
+
+  quint32 magic = 0;
+  quint32 version = 0;
+  in >> magic >> version;
+  if (magic != cacheMagic || version != formatVersion) {
+    file.unmap(mapped);
+    return Status::Missing;
+  }
+  GPGKeyringStamp stamp;
+  qint64 writtenAt = 0;
+  quint32 numKeys = 0;
+  in >> stamp >> writtenAt >> numKeys;
+  if (in.status() != QDataStream::Ok) {
+    file.unmap(mapped);
+    return Status::Missing;
+  }
+  QVector<GPGKeyDetails> keys;
+  // never trust a count from disk for the allocation
+  keys.reserve(int(qMin<quint32>(numKeys, 4096)));
+  // the strings are copied out of the mapping into one arena
+  auto arena = std::make_shared<GPGStringArena>();
+  for (quint32 i = 0; i < numKeys && in.status() == QDataStream::Ok; ++i) {
+    GPGKeyDetails d;
+    d.readFrom(in, arena);
+    keys.append(d);
+  }
+  const bool complete = in.status() == QDataStream::Ok;
+  file.unmap(mapped);
+  if (!complete) {
+    return Status::Missing;
+  }
+  keys_ = keys;
+  const qint64 age =
+      QDateTime::currentMSecsSinceEpoch() / 1000 - writtenAt;
+  if (stamp != stamp_ || age < 0 || age > maxAgeSeconds) {
+    return Status::Stale;
+  }
+  return Status::Valid;
+}
+
+bool GPGKeyCache::save(const GPGKeyringStamp &stamp_,
+                       const QVector<GPGKeyDetails> &keys_) const {
+  if (!QDir().mkpath(QFileInfo(m_fileName).absolutePath())) {
+    return false;
+  }
+  // the cache holds names and mail addresses, keep it private
+  QSaveFile file(m_fileName);
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+  file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+  QDataStream out(&file);
+  out.setVersion(QDataStream::Qt_5_15);
+  out << cacheMagic << formatVersion << stamp_
+      << qint64(QDateTime::currentMSecsSinceEpoch() / 1000)
+      << quint32(keys_.size());
+  for (auto &key : keys_) {
+    key.writeTo(out);
+  }
+  if (out.status() != QDataStream::Ok) {
+    file.cancelWriting();
+    return false;
+  }
+  return file.commit();
+}
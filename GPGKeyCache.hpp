@@ -0,0 +1,77 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief A small on-disk cache of the last keylisting, so the key table
+ * can be shown right after Kate starts instead of waiting for gpg.
+ * The file is a versioned binary snapshot of GPGKeyDetails, stored with
+ * the GPGKeyringStamp it was listed at. It is memory mapped for reading.
+ * A snapshot whose stamp no longer matches the keyring is still returned
+ * (as stale), so it can be shown until a fresh listing is done.
+ */
+
+#include <GPGKeyDetails.hpp>
+#include <GPGKeyringStamp.hpp>
+#include <QString>
+#include <QVector>
+
+class GPGKeyCache {
+public:
+  enum class Status {
+    Missing, // no usable snapshot
+    Stale,   // the keyring has changed since the snapshot was written
+    Valid    // the snapshot matches the keyring
+  };
+
+  // bump this whenever the file layout or GPGKeyDetails::writeTo() changes
+  static const quint32 formatVersion = 2;
+
+  // Even with an unchanged keyring, keys expire and the trust database is
+  // updated now and then, so snapshots older than this count as stale.
+  static const qint64 maxAgeSeconds = 24 * 60 * 60;
+
+  GPGKeyCache();
+
+  // $XDG_CACHE_HOME/kate_gpg_plugin/keys.cache
+  static QString defaultFileName();
+
+  /**
+   * @brief Reads the snapshot (all keys, the filters are applied later).
+   * @param stamp_ The current keyring stamp.
+   * @param keys_ Receives the keys unless the status is Missing.
+   * @return See Status.
+   */
+  Status load(const GPGKeyringStamp &stamp_,
+              QVector<GPGKeyDetails> &keys_) const;
+
+  /**
+   * @brief Replaces the snapshot. The file is written atomically and is
+   *        only readable by the user.
+   * @param stamp_ The keyring stamp taken before the keys were listed.
+   * @return false if the file could not be written.
+   */
+  bool save(const GPGKeyringStamp &stamp_,
+            const QVector<GPGKeyDetails> &keys_) const;
+
+  void setFileName(const QString &fileName_);
+  QString fileName() const;
+
+private:
+  QString m_fileName;
+};
@@ -16,56 +16,239 @@
  */
 
 #include <QDateTime>
+#include <cassert>
 #include <string>
 #include <vector>
 #include <GPGKeyDetails.hpp>
 
+namespace {
+
+// "<Bob@Example.org> " -> "Bob@Example.org"
+QStringView stripMailAddress(QStringView mailAddress_) {
+  QStringView address = mailAddress_.trimmed();
+  if (address.size() >= 2 && address.startsWith(QLatin1Char('<')) &&
+      address.endsWith(QLatin1Char('>'))) {
+    address = address.mid(1, address.size() - 2).trimmed();
+  }
+  return address;
+}
+
+} // namespace
+
 GPGKeyDetails::GPGKeyDetails() {}
 
-GPGKeyDetails::~GPGKeyDetails() {
-  m_uids.clear();
-  m_mailAddresses.clear();
-  m_subkeyIDs.clear();
+// the views need no cleanup, the arena goes with the last key using it
+GPGKeyDetails::~GPGKeyDetails() {}
+
+QString GPGKeyDetails::fingerPrint() const { return m_fingerPrint.toString(); }
+
+QString GPGKeyDetails::keyID() const { return m_keyID.toString(); }
+
+QString GPGKeyDetails::keyType() const { return m_keyType.toString(); }
+
+QString GPGKeyDetails::keyLength() const { return m_keyLength.toString(); }
+
+QString GPGKeyDetails::creationDate() const {
+  return m_creationDate.toString();
 }
 
-QString GPGKeyDetails::fingerPrint() const { return m_fingerPrint; }
+QString GPGKeyDetails::expiryDate() const { return m_expiryDate.toString(); }
 
-QString GPGKeyDetails::keyID() const { return m_keyID; }
+QStringView GPGKeyDetails::fingerPrintView() const { return m_fingerPrint; }
 
-QString GPGKeyDetails::keyType() const { return m_keyType; }
+QStringView GPGKeyDetails::keyLengthView() const { return m_keyLength; }
 
-QString GPGKeyDetails::keyLength() const { return m_keyLength; }
+QStringView GPGKeyDetails::creationDateView() const { return m_creationDate; }
 
-QString GPGKeyDetails::creationDate() const { return m_creationDate; }
+QStringView GPGKeyDetails::expiryDateView() const { return m_expiryDate; }
 
-QString GPGKeyDetails::expiryDate() const { return m_expiryDate; }
+const GPGStringViewList& GPGKeyDetails::uids() const { return m_uids; }
 
-const QVector<QString>& GPGKeyDetails::uids() const { return m_uids; }
+const GPGStringViewList& GPGKeyDetails::mailAdresses() const { return m_mailAddresses; }
 
-const QVector<QString>& GPGKeyDetails::mailAdresses() const { return m_mailAddresses; }
+const GPGStringViewList& GPGKeyDetails::subkeyIDs() const { return m_subkeyIDs; }
 
-const QVector<QString>& GPGKeyDetails::subkeyIDs() const { return m_subkeyIDs; }
+const GPGStringViewList& GPGKeyDetails::allSubkeyIDs() const { return m_allSubkeyIDs; }
 
 size_t GPGKeyDetails::getNumUIds() const { return m_uids.size(); }
 
+bool GPGKeyDetails::hasSecret() const { return m_hasSecret; }
+
+QString GPGKeyDetails::normalizedMailAddress(QStringView mailAddress_) {
+  // case folding, like QStringView::compare() with Qt::CaseInsensitive
+  return stripMailAddress(mailAddress_).toString().toCaseFolded();
+}
+
+bool GPGKeyDetails::sameMailAddress(QStringView a_, QStringView b_) {
+  const QStringView a = stripMailAddress(a_);
+  return !a.isEmpty() &&
+         a.compare(stripMailAddress(b_), Qt::CaseInsensitive) == 0;
+}
+
+bool GPGKeyDetails::hasMailAddress(QStringView mailAddress_) const {
+  for (auto &mail : m_mailAddresses) {
+    if (sameMailAddress(mail, mailAddress_)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GPGKeyDetails::setHasSecret(bool hasSecret_) { m_hasSecret = hasSecret_; }
+
+qint64 GPGKeyDetails::creationTime() const { return m_creationTime; }
+
+qint64 GPGKeyDetails::expiryTime() const { return m_expiryTime; }
+
+bool GPGKeyDetails::isExpired() const {
+  return m_expired || (m_expiryTime > 0 &&
+                       m_expiryTime <= QDateTime::currentSecsSinceEpoch());
+}
+
 const QString timestampToQString(const time_t timestamp_) {
   QDateTime dt;
   dt.setTime_t(timestamp_);
   return dt.toString(QString("yyyy-MM-dd"));
 }
 
-void GPGKeyDetails::loadFromGPGMeKey(GpgME::Key key_) {
-  m_fingerPrint = QString(key_.primaryFingerprint());
-  m_keyID = QString(key_.shortKeyID());
-  m_keyType = QString::fromStdString(key_.subkey(0).algoName());
-  m_keyLength = QString::number(key_.subkey(0).length());
-  m_creationDate = QString(timestampToQString(key_.subkey(0).creationTime()));
-  m_expiryDate = QString(timestampToQString(key_.subkey(0).expirationTime()));
+void GPGKeyDetails::loadFromGPGMeKey(GpgME::Key key_,
+                                     std::shared_ptr<GPGStringArena> arena_) {
+  assert(arena_);
+  m_arena = arena_;
+  GPGStringArena &arena = *m_arena;
+  m_fingerPrint = arena.copyUtf8(key_.primaryFingerprint());
+  m_keyID = arena.copyUtf8(key_.shortKeyID());
+  m_keyType = arena.copyUtf8(key_.subkey(0).algoName().c_str());
+  m_keyLength = arena.copy(QString::number(key_.subkey(0).length()));
+  m_creationDate =
+      arena.copy(timestampToQString(key_.subkey(0).creationTime()));
+  m_expiryDate =
+      arena.copy(timestampToQString(key_.subkey(0).expirationTime()));
+  m_creationTime = key_.subkey(0).creationTime();
+  m_expiryTime = key_.subkey(0).neverExpires()
+                     ? 0
+                     : qint64(key_.subkey(0).expirationTime());
+  m_expired = key_.isExpired();
+  m_hasSecret = key_.hasSecret();
   const std::vector<GpgME::UserID>& ids = key_.userIDs();
-  for (auto &id : ids) {
-      m_uids.push_back(id.name());
-      m_mailAddresses.push_back(id.email());
-      m_subkeyIDs.push_back(key_.subkey(1).keyID());
+  const int numUids = int(ids.size());
+  QStringView *uids = arena.allocateList(numUids);
+  QStringView *mailAddresses = arena.allocateList(numUids);
+  QStringView *subkeyIDs = arena.allocateList(numUids);
+  const QStringView subkeyID = arena.copyUtf8(key_.subkey(1).keyID());
+  for (auto i = 0; i < numUids; ++i) {
+      uids[i] = arena.copyUtf8(ids.at(i).name());
+      mailAddresses[i] = arena.copyUtf8(ids.at(i).email());
+      subkeyIDs[i] = subkeyID;
+  }
+  m_uids = GPGStringViewList(uids, numUids);
+  m_mailAddresses = GPGStringViewList(mailAddresses, numUids);
+  m_subkeyIDs = GPGStringViewList(subkeyIDs, numUids);
+  const std::vector<GpgME::Subkey> subkeys = key_.subkeys();
+  QStringView *allSubkeyIDs = arena.allocateList(int(subkeys.size()));
+  for (size_t i = 0; i < subkeys.size(); ++i) {
+      allSubkeyIDs[i] = arena.copyUtf8(subkeys.at(i).keyID());
+  }
+  m_allSubkeyIDs = GPGStringViewList(allSubkeyIDs, int(subkeys.size()));
+}
+
+void GPGKeyDetails::loadFromValues(const QString &fingerPrint_,
+                                   const QString &keyType_, int keyLength_,
+                                   qint64 creationTime_, qint64 expiryTime_,
+                                   const QVector<QString> &uids_,
+                                   const QVector<QString> &mailAddresses_,
+                                   std::shared_ptr<GPGStringArena> arena_) {
+  assert(arena_);
+  m_arena = arena_;
+  GPGStringArena &arena = *m_arena;
+  m_fingerPrint = arena.copy(fingerPrint_);
+  m_keyID = m_fingerPrint.right(8);
+  m_keyType = arena.copy(keyType_);
+  m_keyLength = arena.copy(QString::number(keyLength_));
+  m_creationDate = arena.copy(timestampToQString(creationTime_));
+  m_expiryDate = arena.copy(timestampToQString(expiryTime_));
+  m_creationTime = creationTime_;
+  m_expiryTime = expiryTime_;
+  m_expired = false;
+  m_uids = arena.copyList(uids_);
+  m_mailAddresses = arena.copyList(mailAddresses_);
+  QStringView *subkeyIDs = arena.allocateList(uids_.size());
+  for (auto i = 0; i < uids_.size(); ++i) {
+    subkeyIDs[i] = m_fingerPrint.right(16);
+  }
+  m_subkeyIDs = GPGStringViewList(subkeyIDs, uids_.size());
+  QStringView *allSubkeyIDs = arena.allocateList(1);
+  allSubkeyIDs[0] = m_fingerPrint.right(16);
+  m_allSubkeyIDs = GPGStringViewList(allSubkeyIDs, 1);
+}
+
+void GPGKeyDetails::writeTo(QDataStream &out_) const {
+  // the same layout as QString and QVector<QString>, see readFrom()
+  out_ << m_fingerPrint.toString() << m_keyID.toString()
+       << m_keyType.toString() << m_keyLength.toString()
+       << m_creationDate.toString() << m_expiryDate.toString()
+       << m_uids.toVector() << m_mailAddresses.toVector()
+       << m_subkeyIDs.toVector() << m_allSubkeyIDs.toVector() << m_hasSecret
+       << m_expired << m_creationTime << m_expiryTime;
+}
+
+void GPGKeyDetails::readFrom(QDataStream &in_,
+                             std::shared_ptr<GPGStringArena> arena_) {
+  assert(arena_);
+  m_arena = arena_;
+  GPGStringArena &arena = *m_arena;
+  // straight into the arena, no temporary QStrings
+  m_fingerPrint = arena.read(in_);
+  m_keyID = arena.read(in_);
+  m_keyType = arena.read(in_);
+  m_keyLength = arena.read(in_);
+  m_creationDate = arena.read(in_);
+  m_expiryDate = arena.read(in_);
+  m_uids = arena.readList(in_);
+  m_mailAddresses = arena.readList(in_);
+  m_subkeyIDs = arena.readList(in_);
+  m_allSubkeyIDs = arena.readList(in_);
+  in_ >> m_hasSecret >> m_expired >> m_creationTime >> m_expiryTime;
+  if (in_.status() != QDataStream::Ok ||
+      m_mailAddresses.size() != m_uids.size() ||
+      m_subkeyIDs.size() != m_uids.size()) {
+    // the lists are read in parallel by index
+    in_.setStatus(QDataStream::ReadCorruptData);
   }
+}
+
+bool GPGKeyFilter::accepts(const GPGKeyDetails &key_) const {
+  if (showOnlyPrivateKeys && !key_.hasSecret()) {
+    return false;
+  }
+  if (hideExpiredKeys && key_.isExpired()) {
+    return false;
+  }
+  if (searchPattern.isEmpty()) {
+    return true;
+  }
+  // like gpg's own substring search, plus (the end of) a fingerprint
+  for (auto i = 0; i < key_.uids().size(); ++i) {
+    if (key_.uids().at(i).contains(searchPattern, Qt::CaseInsensitive) ||
+        key_.mailAdresses().at(i).contains(searchPattern,
+                                           Qt::CaseInsensitive)) {
+      return true;
+    }
+  }
+  QString hexPattern = searchPattern;
+  if (hexPattern.startsWith(QLatin1String("0x"), Qt::CaseInsensitive)) {
+    hexPattern = hexPattern.mid(2);
+  }
+  return !hexPattern.isEmpty() &&
+         key_.fingerPrintView().endsWith(hexPattern, Qt::CaseInsensitive);
+}
+
+bool GPGKeyFilter::operator==(const GPGKeyFilter &other_) const {
+  return showOnlyPrivateKeys == other_.showOnlyPrivateKeys &&
+         hideExpiredKeys == other_.hideExpiredKeys &&
+         searchPattern == other_.searchPattern;
+}
 
+bool GPGKeyFilter::operator!=(const GPGKeyFilter &other_) const {
+  return !(*this == other_);
 }
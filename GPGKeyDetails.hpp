@@ -19,11 +19,16 @@
 
 /**
  * @brief This class contains the details for a GPG key
+ * The strings live in the GPGStringArena of the listing the key came
+ * from; the key keeps that arena alive. Copying a key copies no strings.
  **/
 
+#include <GPGStringArena.hpp>
+#include <QDataStream>
 #include <QString>
 #include <QVector>
 #include <gpgme++/key.h>
+#include <memory>
 
 class GPGKeyDetails {
 public:
@@ -31,28 +36,87 @@ public:
 
   ~GPGKeyDetails();
 
+  // these return copies, see the *View() functions for the hot paths
   QString fingerPrint() const;
   QString keyID() const;
   QString keyType() const;
   QString keyLength() const;
   QString creationDate() const;
   QString expiryDate() const;
-  const QVector<QString>& uids() const;   // this returns a list of all names per key
-  const QVector<QString>& mailAdresses() const;   // this returns a list of all email addresses associated with this key
-  const QVector<QString>& subkeyIDs() const;   // this returns a list of all "IDs" per key
+  // no copies, valid as long as (a copy of) this key exists
+  QStringView fingerPrintView() const;
+  QStringView keyLengthView() const;
+  QStringView creationDateView() const;
+  QStringView expiryDateView() const;
+  const GPGStringViewList& uids() const;   // this returns a list of all names per key
+  const GPGStringViewList& mailAdresses() const;   // this returns a list of all email addresses associated with this key
+  const GPGStringViewList& subkeyIDs() const;   // this returns a list of all "IDs" per key
+  const GPGStringViewList& allSubkeyIDs() const;   // this returns the 16 digit key IDs of the primary key and all subkeys
 
   size_t getNumUIds() const;
 
-  void loadFromGPGMeKey(GpgME::Key key_);
+  bool hasSecret() const;      // a private key is available
+  qint64 creationTime() const; // seconds since the epoch
+  qint64 expiryTime() const;   // seconds since the epoch, 0 = never expires
+  bool isExpired() const;      // right now, not just when it was listed
+
+  /**
+   * Mail addresses match exactly, apart from case, surrounding whitespace
+   * and angle brackets. Every recipient lookup compares addresses this
+   * way, so an address resolves to the same key on every path.
+   */
+  static QString normalizedMailAddress(QStringView mailAddress_);
+  static bool sameMailAddress(QStringView a_, QStringView b_);
+  bool hasMailAddress(QStringView mailAddress_) const;
+
+  /**
+   * The load functions copy the strings into arena_, which must not be
+   * null. Share it between all keys of one listing, or of one batch of
+   * it: an arena per key costs two allocations and a whole chunk each.
+   */
+  void loadFromGPGMeKey(GpgME::Key key_,
+                        std::shared_ptr<GPGStringArena> arena_);
+
+  // for keys that do not come from gpgme (see GPGFakeBackend)
+  void loadFromValues(const QString &fingerPrint_, const QString &keyType_,
+                      int keyLength_, qint64 creationTime_,
+                      qint64 expiryTime_, const QVector<QString> &uids_,
+                      const QVector<QString> &mailAddresses_,
+                      std::shared_ptr<GPGStringArena> arena_);
+
+  // the secret listing is separate from the public one
+  void setHasSecret(bool hasSecret_);
+
+  // (de)serialization for the on-disk key cache (see GPGKeyCache)
+  void writeTo(QDataStream &out_) const;
+  void readFrom(QDataStream &in_, std::shared_ptr<GPGStringArena> arena_);
 
 private:
-  QString m_fingerPrint;
-  QString m_keyID;
-  QString m_keyType;
-  QString m_keyLength;
-  QString m_creationDate;
-  QString m_expiryDate;
-  QVector<QString> m_uids;
-  QVector<QString> m_mailAddresses;
-  QVector<QString> m_subkeyIDs;
+  std::shared_ptr<GPGStringArena> m_arena;  // owns all strings below
+  QStringView m_fingerPrint;
+  QStringView m_keyID;
+  QStringView m_keyType;
+  QStringView m_keyLength;
+  QStringView m_creationDate;
+  QStringView m_expiryDate;
+  GPGStringViewList m_uids;
+  GPGStringViewList m_mailAddresses;
+  GPGStringViewList m_subkeyIDs;
+  GPGStringViewList m_allSubkeyIDs;
+  bool m_hasSecret = false;
+  bool m_expired = false;
+  qint64 m_creationTime = 0;
+  qint64 m_expiryTime = 0;
+};
+
+// The key table filters. They are applied to the loaded keys in memory.
+struct GPGKeyFilter {
+  bool showOnlyPrivateKeys = false;
+  bool hideExpiredKeys = false;
+  QString searchPattern;  // part of a user ID, mail address or fingerprint
+
+  bool accepts(const GPGKeyDetails &key_) const;
+
+  bool operator==(const GPGKeyFilter &other_) const;
+  bool operator!=(const GPGKeyFilter &other_) const;
 };
@@ -0,0 +1,80 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGEngineStats.hpp>
+#include <GPGKeyLoader.hpp>
+#include <QMutexLocker>
+#include <utility>
+
+/// class functions
+GPGKeyLoader::GPGKeyLoader(GPGBackend *backend_, QObject *parent_)
+    : QObject(parent_), m_backend(backend_) {
+  // one listing at a time, a superseded one simply runs to its end
+  m_pool.setMaxThreadCount(1);
+}
+
+GPGKeyLoader::~GPGKeyLoader() { m_pool.waitForDone(); }
+
+bool GPGKeyLoader::isRunning() const {
+  QMutexLocker locker(&m_mutex);
+  return m_finishedRequestID != m_latestRequestID;
+}
+
+quint64 GPGKeyLoader::start() {
+  quint64 requestID;
+  {
+    QMutexLocker locker(&m_mutex);
+    requestID = ++m_latestRequestID;
+  }
+  const GPGEngineStats::Action action = GPGEngineStats::currentAction();
+  m_pool.start([this, requestID, action]() {
+    GPGEngineStats::ActionScope scope(action);
+    {
+      QMutexLocker locker(&m_mutex);
+      if (requestID != m_latestRequestID) {
+        return; // superseded before it even started
+      }
+    }
+    // stamp first: if the keyring changes while listing, the result is
+    // stored with the old stamp and counts as stale next time
+    const GPGKeyringStamp stamp = GPGKeyringStamp::current();
+    GPGKeyListing listing = m_backend->listKeySnapshot();
+    {
+      QMutexLocker locker(&m_mutex);
+      if (requestID != m_latestRequestID) {
+        return;
+      }
+      m_listing = std::move(listing);
+      m_stamp = stamp;
+      m_finishedRequestID = requestID;
+    }
+    emit finished(requestID);
+  });
+  return requestID;
+}
+
+bool GPGKeyLoader::takeKeys(quint64 requestID_, GPGKeyListing &listing_,
+                            GPGKeyringStamp &stamp_) {
+  QMutexLocker locker(&m_mutex);
+  if (requestID_ != m_latestRequestID || requestID_ != m_finishedRequestID) {
+    return false;
+  }
+  listing_ = std::move(m_listing);
+  m_listing = GPGKeyListing();
+  stamp_ = m_stamp;
+  return true;
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Runs the gpg keylisting on a worker thread, so the toolview
+ * stays responsive while gpg walks the keyring. Only the newest listing
+ * counts: starting a new one supersedes any listing that is still
+ * running, and its result is dropped.
+ */
+
+#include <GPGBackend.hpp>
+#include <GPGKeyringStamp.hpp>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+class GPGKeyLoader : public QObject {
+  Q_OBJECT
+
+public:
+  explicit GPGKeyLoader(GPGBackend *backend_, QObject *parent_ = nullptr);
+
+  ~GPGKeyLoader();
+
+  /**
+   * @brief Starts listing all keys (see GPGBackend::listKeySnapshot()).
+   *        Returns immediately, finished() is emitted when the listing
+   *        is done.
+   * @return The ID of this listing.
+   */
+  quint64 start();
+
+  bool isRunning() const;
+
+  /**
+   * @brief Takes the result of a finished listing.
+   * @param requestID_ The ID passed by finished().
+   * @param listing_ Receives the listed keys.
+   * @param stamp_ Receives the keyring stamp taken before listing.
+   * @return false if the listing was superseded by a newer one.
+   */
+  bool takeKeys(quint64 requestID_, GPGKeyListing &listing_,
+                GPGKeyringStamp &stamp_);
+
+signals:
+  void finished(quint64 requestID);
+
+private:
+  GPGBackend *m_backend;
+  QThreadPool m_pool;
+  mutable QMutex m_mutex;
+  quint64 m_latestRequestID = 0;
+  quint64 m_finishedRequestID = 0;
+  GPGKeyListing m_listing;
+  GPGKeyringStamp m_stamp;
+};
@@ -0,0 +1,205 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGEngineStats.hpp>
+#include <GPGKeyPipeline.hpp>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+#include <gpgme++/context.h>
+#include <gpgme++/keylistresult.h>
+#include <map>
+#include <memory>
+#include <thread>
+
+/// local functions
+namespace {
+
+template <class Key> struct Batch {
+  int sequence = 0;
+  std::vector<Key> keys;
+};
+
+// The bounded queue between the producer and the converters, plus the
+// converted batches by sequence number.
+template <class Key> class BatchQueue {
+public:
+  void push(Batch<Key> &&batch_) {
+    QMutexLocker locker(&m_mutex);
+    while (m_queue.size() >= GPGKeyPipeline::maxQueuedBatches) {
+      m_notFull.wait(&m_mutex);
+    }
+    m_queue.enqueue(std::move(batch_));
+    m_notEmpty.wakeOne();
+  }
+
+  // returns false once the producer is done and the queue is empty
+  bool pop(Batch<Key> &batch_) {
+    QMutexLocker locker(&m_mutex);
+    while (m_queue.isEmpty() && !m_done) {
+      m_notEmpty.wait(&m_mutex);
+    }
+    if (m_queue.isEmpty()) {
+      return false;
+    }
+    batch_ = m_queue.dequeue();
+    m_notFull.wakeOne();
+    return true;
+  }
+
+  void finish() {
+    QMutexLocker locker(&m_mutex);
+    m_done = true;
+    m_notEmpty.wakeAll();
+  }
+
+  void store(int sequence_, QVector<GPGKeyDetails> &&details_) {
+    QMutexLocker locker(&m_resultMutex);
+    m_results[sequence_] = std::move(details_);
+  }
+
+  // the converted batches in sequence order
+  std::map<int, QVector<GPGKeyDetails>> &results() { return m_results; }
+
+private:
+  QMutex m_mutex;
+  QWaitCondition m_notEmpty;
+  QWaitCondition m_notFull;
+  QQueue<Batch<Key>> m_queue;
+  bool m_done = false;
+
+  QMutex m_resultMutex;
+  std::map<int, QVector<GPGKeyDetails>> m_results;
+};
+
+template <class Key>
+QVector<GPGKeyDetails>
+convert(const std::vector<Key> &keys_,
+        const std::function<GPGKeyDetails(
+            const Key &, const std::shared_ptr<GPGStringArena> &)> &convert_) {
+  QVector<GPGKeyDetails> details;
+  details.reserve(int(keys_.size()));
+  // one arena per batch, so the converters never share one
+  auto arena = std::make_shared<GPGStringArena>();
+  for (auto &key : keys_) {
+    details.push_back(convert_(key, arena));
+  }
+  return details;
+}
+
+} // namespace
+
+/// class functions
+int GPGKeyPipeline::defaultNumConverters() {
+  return qBound(1, QThread::idealThreadCount() - 1, 8);
+}
+
+void GPGKeyPipeline::listKeys(bool secretOnly_, const QString &searchPattern_,
+                              std::vector<GpgME::Key> &keys_,
+                              QVector<GPGKeyDetails> &details_,
+                              int numConverters_) {
+  keys_.clear();
+  details_.clear();
+  GpgME::Error err;
+  GpgME::initializeLibrary();
+  auto ctx = std::unique_ptr<GpgME::Context>(
+      GpgME::Context::createForProtocol(GpgME::OpenPGP));
+  ctx->setKeyListMode(0);
+  GPGEngineStats::record(GPGEngineOp::KeyListing);
+  err = ctx->startKeyListing(searchPattern_.toUtf8().constData(),
+                             secretOnly_);
+  if (err) {
+    return;
+  }
+  run<GpgME::Key>(
+      [&ctx, &err](GpgME::Key &key_) {
+        key_ = ctx->nextKey(err);
+        return !err.code();
+      },
+      [](const GpgME::Key &key_,
+         const std::shared_ptr<GPGStringArena> &arena_) {
+        GPGKeyDetails d;
+        d.loadFromGPGMeKey(key_, arena_);
+        return d;
+      },
+      keys_, details_, numConverters_);
+}
+
+template <class Key>
+void GPGKeyPipeline::run(
+    const std::function<bool(Key &)> &nextKey_,
+    const std::function<GPGKeyDetails(
+        const Key &, const std::shared_ptr<GPGStringArena> &)> &convert_,
+    std::vector<Key> &keys_, QVector<GPGKeyDetails> &details_,
+    int numConverters_) {
+  keys_.clear();
+  details_.clear();
+  const int numConverters =
+      numConverters_ > 0 ? numConverters_ : defaultNumConverters();
+
+  BatchQueue<Key> queue;
+  std::vector<std::thread> converters;
+  Batch<Key> batch;
+  Key key{};
+  while (nextKey_(key)) {
+    keys_.push_back(key);
+    batch.keys.push_back(key);
+    if (int(batch.keys.size()) < batchSize) {
+      continue;
+    }
+    // the converters are started with the first full batch
+    if (converters.empty()) {
+      for (auto i = 0; i < numConverters; ++i) {
+        converters.emplace_back([&queue, &convert_]() {
+          Batch<Key> work;
+          while (queue.pop(work)) {
+            queue.store(work.sequence, convert(work.keys, convert_));
+          }
+        });
+      }
+    }
+    const int sequence = batch.sequence;
+    queue.push(std::move(batch));
+    batch = Batch<Key>();
+    batch.sequence = sequence + 1;
+  }
+
+  // the last (partial) batch is converted here while the others finish
+  QVector<GPGKeyDetails> lastDetails = convert(batch.keys, convert_);
+  queue.finish();
+  for (auto &converter : converters) {
+    converter.join();
+  }
+  details_.reserve(int(keys_.size()));
+  for (auto &result : queue.results()) {
+    details_ += result.second;
+  }
+  details_ += lastDetails;
+}
+
+template void GPGKeyPipeline::run<GpgME::Key>(
+    const std::function<bool(GpgME::Key &)> &,
+    const std::function<GPGKeyDetails(
+        const GpgME::Key &, const std::shared_ptr<GPGStringArena> &)> &,
+    std::vector<GpgME::Key> &, QVector<GPGKeyDetails> &, int);
+template void GPGKeyPipeline::run<int>(
+    const std::function<bool(int &)> &,
+    const std::function<GPGKeyDetails(
+        const int &, const std::shared_ptr<GPGStringArena> &)> &,
+    std::vector<int> &, QVector<GPGKeyDetails> &, int);
@@ -0,0 +1,80 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Lists keys and converts them to GPGKeyDetails at the same time.
+ * The calling thread is the producer: it reads keys from gpg and pushes
+ * every full batch into a bounded queue. The converter threads are
+ * started with the first full batch and convert while gpg is still
+ * listing the rest, so listing and conversion overlap. A full queue
+ * blocks the producer until a converter catches up. Every batch keeps
+ * its sequence number, so the details come out in listing order no
+ * matter which thread converted them. The last, partial batch is
+ * converted by the producer once the listing is done. A keyring smaller
+ * than one batch is therefore converted without starting any threads.
+ */
+
+#include <GPGKeyDetails.hpp>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include <gpgme++/key.h>
+#include <memory>
+#include <vector>
+
+class GPGKeyPipeline {
+public:
+  static const int batchSize = 256;
+  // keeps the producer from running ahead of the converters
+  static const int maxQueuedBatches = 8;
+
+  // one thread less than cores, the producer and gpg need one too
+  static int defaultNumConverters();
+
+  /**
+   * @brief Lists keys like GPGMeWrapper::listKeys() and converts them.
+   * @param secretOnly_ List only keys with a private key.
+   * @param searchPattern_ The gpg search pattern.
+   * @param keys_ Receives the keys in listing order.
+   * @param details_ Receives the details of keys_ in the same order.
+   * @param numConverters_ Number of converter threads (for measuring the
+   *                       speedup, 0 = defaultNumConverters()).
+   */
+  static void listKeys(bool secretOnly_, const QString &searchPattern_,
+                       std::vector<GpgME::Key> &keys_,
+                       QVector<GPGKeyDetails> &details_,
+                       int numConverters_ = 0);
+
+  /**
+   * @brief The pipeline behind listKeys(), for any kind of key. It is
+   *        instantiated for GpgME::Key and for int, the index of a made up
+   *        key in the benchmark (tests/GPGKeyPipelineTest).
+   * @param nextKey_ Reads the next key on the calling thread, false at the
+   *                 end of the listing.
+   * @param convert_ Converts one key into the arena of its batch, on any
+   *                 thread.
+   */
+  template <class Key>
+  static void
+  run(const std::function<bool(Key &)> &nextKey_,
+      const std::function<GPGKeyDetails(
+          const Key &, const std::shared_ptr<GPGStringArena> &)> &convert_,
+      std::vector<Key> &keys_, QVector<GPGKeyDetails> &details_,
+      int numConverters_ = 0);
+};
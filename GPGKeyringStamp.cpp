@@ -0,0 +1,74 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGKeyringStamp.hpp>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <gpgme++/global.h>
+
+/// local functions
+// Public keys live in pubring.kbx (or pubring.gpg for old keyrings),
+// secret keys in private-keys-v1.d (or secring.gpg). The trust database
+// changes validity and ownertrust.
+const char *const keyringFiles[] = {"pubring.kbx", "pubring.gpg",
+                                    "private-keys-v1.d", "secring.gpg",
+                                    "trustdb.gpg"};
+
+/// class functions
+GPGKeyringStamp::GPGKeyringStamp() {}
+
+QString GPGKeyringStamp::homeDirectory() {
+  GpgME::initializeLibrary();
+  const char *homeDir = GpgME::dirInfo("homedir");
+  if (homeDir) {
+    return QString::fromLocal8Bit(homeDir);
+  }
+  return QDir::homePath() + QStringLiteral("/.gnupg");
+}
+
+GPGKeyringStamp GPGKeyringStamp::current() {
+  GPGKeyringStamp stamp;
+  const QDir homeDir(homeDirectory());
+  for (auto file : keyringFiles) {
+    const QFileInfo info(homeDir.filePath(QString::fromLatin1(file)));
+    if (info.exists()) {
+      stamp.m_values.append(info.lastModified().toMSecsSinceEpoch());
+      stamp.m_values.append(info.size());
+    } else {
+      stamp.m_values.append(-1);
+      stamp.m_values.append(-1);
+    }
+  }
+  return stamp;
+}
+
+bool GPGKeyringStamp::operator==(const GPGKeyringStamp &other_) const {
+  return m_values == other_.m_values;
+}
+
+bool GPGKeyringStamp::operator!=(const GPGKeyringStamp &other_) const {
+  return !(*this == other_);
+}
+
+QDataStream &operator<<(QDataStream &out_, const GPGKeyringStamp &stamp_) {
+  return out_ << stamp_.m_values;
+}
+
+QDataStream &operator>>(QDataStream &in_, GPGKeyringStamp &stamp_) {
+  return in_ >> stamp_.m_values;
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief The modification times and sizes of the keyring files in the
+ * GnuPG home directory. Two stamps compare equal as long as nobody has
+ * imported, deleted or changed a key, which makes this a cheap way (a few
+ * stat() calls) to find out if anything derived from a keylisting is stale.
+ */
+
+#include <QDataStream>
+#include <QString>
+#include <QVector>
+
+class GPGKeyringStamp {
+public:
+  GPGKeyringStamp();
+
+  // stats the keyring files right now
+  static GPGKeyringStamp current();
+
+  // the GnuPG home directory as reported by gpgme
+  static QString homeDirectory();
+
+  bool operator==(const GPGKeyringStamp &other_) const;
+  bool operator!=(const GPGKeyringStamp &other_) const;
+
+  // for storing a stamp next to cached data (see GPGKeyCache)
+  friend QDataStream &operator<<(QDataStream &out_,
+                                 const GPGKeyringStamp &stamp_);
+  friend QDataStream &operator>>(QDataStream &in_, GPGKeyringStamp &stamp_);
+
+private:
+  QVector<qint64> m_values;  // mtime and size for each keyring file
+};
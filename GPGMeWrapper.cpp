@@ -15,6 +15,9 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <GPGEngineStats.hpp>
+#include <GPGEntropyEstimator.hpp>
+#include <GPGKeyPipeline.hpp>
 #include <GPGMeWrapper.hpp>
 #include <gpgme++/context.h>
 #include <gpgme++/data.h>
@@ -22,6 +25,10 @@
 #include <gpgme++/encryptionresult.h>
 #include <gpgme++/key.h>
 #include <gpgme++/keylistresult.h>
+#include <gpgme++/signingresult.h>
+#include <gpgme++/verificationresult.h>
+#include <algorithm>
+#include <thread>
 #include <vector>
 
 /// local functions
@@ -34,7 +41,9 @@ QVector<QString> getUIDsForKey(GpgME::Key key) {
 }
 
 /// class functions
-GPGMeWrapper::GPGMeWrapper() { loadKeys(false, true, ""); }
+// Keys are not listed here, the view loads them from the key cache and
+// lists them in the background (see GPGKeyLoader).
+GPGMeWrapper::GPGMeWrapper() {}
 
 GPGMeWrapper::~GPGMeWrapper() { m_keys.clear(); }
 
@@ -44,6 +53,37 @@ void GPGMeWrapper::setSelectedKeyIndex(uint newSelectedKeyIndex) {
   m_selectedKeyIndex = newSelectedKeyIndex;
 }
 
+GPGPlaintextCache &GPGMeWrapper::plaintextCache() { return m_plaintextCache; }
+
+GPGRecipientCache &GPGMeWrapper::recipientCache() { return m_recipientCache; }
+
+void GPGMeWrapper::setCompressionMode(GPGCompressionMode compressionMode_) {
+  m_compressionMode = compressionMode_;
+}
+
+GPGCompressionMode GPGMeWrapper::compressionMode() const {
+  return m_compressionMode;
+}
+
+void GPGMeWrapper::setPassphraseProvider(
+    GPGPassphraseProvider *passphraseProvider_) {
+  m_passphraseProvider = passphraseProvider_;
+}
+
+GPGPassphraseProvider *GPGMeWrapper::passphraseProvider() const {
+  return m_passphraseProvider;
+}
+
+quint64 GPGMeWrapper::keyringGeneration() {
+  const GPGKeyringStamp stamp = GPGKeyringStamp::current();
+  if (stamp != m_keyringStamp) {
+    m_keyringStamp = stamp;
+    ++m_keyringGeneration;
+    m_recipientCache.clear();
+  }
+  return m_keyringGeneration;
+}
+
 std::vector<GpgME::Key> GPGMeWrapper::listKeys(bool showOnlyPrivateKeys_, const QString &searchPattern_) {
   GpgME::Error err;
   GpgME::Protocol protocol = GpgME::OpenPGP;
@@ -53,6 +93,7 @@ std::vector<GpgME::Key> GPGMeWrapper::listKeys(bool showOnlyPrivateKeys_, const
   unsigned int mode = 0;
   ctx->setKeyListMode(mode);
   std::vector<GpgME::Key> keys;
+  GPGEngineStats::record(GPGEngineOp::KeyListing);
   err = ctx->startKeyListing(searchPattern_.toUtf8().constData(), showOnlyPrivateKeys_);
   if (err) {
     return keys;
@@ -67,25 +108,145 @@ std::vector<GpgME::Key> GPGMeWrapper::listKeys(bool showOnlyPrivateKeys_, const
   return keys;
 }
 
+GPGKeyListing GPGMeWrapper::listAllKeys(std::vector<GpgME::Key> *keys_) {
+  GPGKeyListing listing;
+  std::vector<GpgME::Key> keys;
+  GpgME::initializeLibrary();
+  // The secret listing is usually much shorter, run it next to the
+  // public one instead of after it.
+  std::vector<GpgME::Key> secretKeys;
+  const GPGEngineStats::Action action = GPGEngineStats::currentAction();
+  std::thread secretListing([&secretKeys, &action]() {
+    GPGEngineStats::ActionScope scope(action);
+    secretKeys = listKeys(true);
+  });
+  GPGKeyPipeline::listKeys(false, QString(), keys, listing.details);
+  secretListing.join();
+  for (auto &key : secretKeys) {
+    listing.secretFingerprints.insert(QString(key.primaryFingerprint()));
+  }
+  if (keys_) {
+    keys_->swap(keys);
+  }
+  return listing;
+}
+
+GPGKeyListing GPGMeWrapper::listKeySnapshot() {
+  std::vector<GpgME::Key> keys;
+  GPGKeyListing listing = listAllKeys(&keys);
+  QMutexLocker locker(&m_listedKeysMutex);
+  m_listedKeys.swap(keys);
+  return listing;
+}
+
+QVector<QStringList>
+GPGMeWrapper::lookupKeyFingerprints(const QStringList &patterns_) {
+  const QVector<std::vector<GpgME::Key>> found = lookupKeys(patterns_);
+  QVector<QStringList> fingerprints(found.size());
+  for (auto i = 0; i < found.size(); ++i) {
+    for (auto &key : found.at(i)) {
+      fingerprints[i].append(QString(key.primaryFingerprint()));
+    }
+  }
+  return fingerprints;
+}
+
 void GPGMeWrapper::loadKeys(bool showOnlyPrivateKeys_, bool hideExpiredKeys_, const QString searchPattern_) {
-  m_keys.clear();
-  GPGOperationResult result;
-  const std::vector<GpgME::Key> keys = listKeys(showOnlyPrivateKeys_, searchPattern_);
-  if (keys.size() == 0) {
-    result.errorMessage.append("Error! No keys found...");
-    return;
+  setKeys(listKeySnapshot());
+  GPGKeyFilter filter;
+  filter.showOnlyPrivateKeys = showOnlyPrivateKeys_;
+  filter.hideExpiredKeys = hideExpiredKeys_;
+  filter.searchPattern = searchPattern_;
+  setKeyFilter(filter);
+}
+
+void GPGMeWrapper::setKeys(const GPGKeyListing &listing_) {
+  m_snapshot.clear();
+  m_snapshot.reserve(listing_.details.size());
+  // Recently used recipients found in this listing are put into the
+  // recipient cache right away, so encrypting to them needs no lookup.
+  const QStringList &recentRecipients = m_recipientCache.recentRecipients();
+  std::vector<GpgME::Key> listedKeys;
+  {
+    QMutexLocker locker(&m_listedKeysMutex);
+    listedKeys.swap(m_listedKeys);
   }
-  for (auto key = keys.begin(); key != keys.end(); ++key) {
-    if (hideExpiredKeys_) {
-      if (key->isExpired()) {
-          continue;
+  // not there if the listing came from another backend
+  const bool haveKeys = int(listedKeys.size()) == listing_.details.size();
+  const quint64 generation =
+      recentRecipients.isEmpty() || !haveKeys ? 0 : keyringGeneration();
+  for (auto i = 0; i < listing_.details.size(); ++i) {
+    GPGKeyDetails d = listing_.details.at(i);
+    const QString fingerprint = d.fingerPrint();
+    if (haveKeys && !recentRecipients.isEmpty() &&
+        m_recipientCache.isRecentFingerprint(fingerprint) &&
+        fingerprint == QLatin1String(listedKeys.at(i).primaryFingerprint())) {
+      for (auto &recent : recentRecipients) {
+        if (recent.startsWith(fingerprint + QLatin1Char(' '))) {
+          m_recipientCache.insert(recent.mid(fingerprint.size() + 1),
+                                  fingerprint, listedKeys.at(i),
+                                  generation);
+        }
       }
     }
-    GPGKeyDetails d;
-    d.loadFromGPGMeKey(*key);
+    d.setHasSecret(listing_.secretFingerprints.contains(fingerprint));
+    m_snapshot.push_back(d);
+  }
+  m_recipientScannerOutdated = true;
+  applyKeyFilter();
+}
+
+void GPGMeWrapper::setKeyFilter(const GPGKeyFilter &filter_) {
+  m_keyFilter = filter_;
+  applyKeyFilter();
+}
+
+const GPGKeyFilter &GPGMeWrapper::keyFilter() const { return m_keyFilter; }
+
+const QVector<GPGKeyDetails> &GPGMeWrapper::allKeys() const {
+  return m_snapshot;
+}
+
+void GPGMeWrapper::applyKeyFilter() {
+  m_keyIDIndex.clear();
+  m_keys.clear();
+  for (auto &d : m_snapshot) {
+    if (!m_keyFilter.accepts(d)) {
+      continue;
+    }
+    for (auto &id : d.allSubkeyIDs()) {
+      m_keyIDIndex.insert(id, m_keys.size());
+    }
     m_keys.push_back(d);
   }
-  return;
+}
+
+GPGKeyCache::Status GPGMeWrapper::loadKeysFromCache() {
+  QVector<GPGKeyDetails> keys;
+  const GPGKeyCache::Status status =
+      m_keyCache.load(GPGKeyringStamp::current(), keys);
+  if (status == GPGKeyCache::Status::Missing) {
+    return status;
+  }
+  m_snapshot = keys;
+  m_recipientScannerOutdated = true;
+  applyKeyFilter();
+  return status;
+}
+
+void GPGMeWrapper::saveKeysToCache(const GPGKeyringStamp &stamp_) {
+  m_keyCache.save(stamp_, m_snapshot);
+}
+
+void GPGMeWrapper::trimMemory() {
+  // assigning empty containers frees their capacity, clear() keeps it
+  m_keyIDIndex = QHash<QStringView, int>();
+  m_keys = QVector<GPGKeyDetails>();
+  m_snapshot = QVector<GPGKeyDetails>();
+  m_recipientScanner = GPGRecipientScanner();
+  m_recipientScannerOutdated = true;
+  m_recipientCache.clear();
+  m_plaintextCache.release();
 }
 
 const QVector<GPGKeyDetails> &GPGMeWrapper::getKeys() const { return m_keys; }
@@ -94,104 +255,456 @@ size_t GPGMeWrapper::getNumKeys() const { return m_keys.size(); }
 
 bool GPGMeWrapper::isPreferredKey(const GPGKeyDetails d_,
                                   const QString &mailAddress_) {
-  for (auto &it : d_.mailAdresses()) {
-    if (it.contains(mailAddress_)) {
-      return true;
+  return d_.hasMailAddress(mailAddress_);
+}
+
+QStringList GPGMeWrapper::suggestRecipients(const QString &text_) {
+  if (m_recipientScannerOutdated) {
+    m_recipientScanner.build(m_snapshot);
+    m_recipientScannerOutdated = false;
+  }
+  return m_recipientScanner.scan(text_);
+}
+
+int GPGMeWrapper::findKeyIndexByKeyID(const QString &keyID_) const {
+  return m_keyIDIndex.value(keyID_.toUpper(), -1);
+}
+
+int GPGMeWrapper::findKeyIndexForRecipients(
+    const QVector<QString> &recipientKeyIDs_) const {
+  // the other recipients' public keys may be loaded too
+  int publicIndex = -1;
+  for (auto &id : recipientKeyIDs_) {
+    const int index = findKeyIndexByKeyID(id);
+    if (index < 0) {
+      continue;
+    }
+    if (m_keys.at(index).hasSecret()) {
+      return index;
+    }
+    if (publicIndex < 0) {
+      publicIndex = index;
     }
   }
-  return false;
+  return publicIndex;
+}
+
+const GPGOperationResult
+GPGMeWrapper::decryptString(const QString &inputString_) {
+  return decrypt(inputString_, false);
 }
 
 const GPGOperationResult
-GPGMeWrapper::decryptString(const QString &inputString_,
-                            const QString &fingerprint_) {
+GPGMeWrapper::decryptAndVerify(const QString &inputString_) {
+  return decrypt(inputString_, true);
+}
+
+void GPGMeWrapper::readVerificationResult(
+    const GpgME::VerificationResult &verification_,
+    GPGOperationResult &result_) const {
+  const std::vector<GpgME::Signature> signatures = verification_.signatures();
+  result_.signatureFound = !signatures.empty();
+  result_.signatureValid = !signatures.empty();
+  for (auto &signature : signatures) {
+    const QString fingerprint(signature.fingerprint());
+    QString signer = fingerprint;
+    const int keyIndex = findKeyIndexByKeyID(fingerprint.right(16));
+    if (keyIndex >= 0) {
+      const GPGKeyDetails &d = m_keys.at(keyIndex);
+      if (d.getNumUIds() > 0) {
+        signer = d.uids().first().toString() + " <" +
+                 d.mailAdresses().first().toString() + "> (" +
+                 fingerprint + ")";
+      }
+    }
+    if (result_.signerFingerprint.isEmpty()) {
+      result_.signerFingerprint = fingerprint;
+    }
+    result_.signatureValid = result_.signatureValid && !signature.status();
+    result_.signatureSummary += describeSignature(signature, signer) + "\n";
+  }
+}
+
+QString GPGMeWrapper::describeSignature(const GpgME::Signature &signature_,
+                                        const QString &signer_) {
+  if (signature_.summary() & GpgME::Signature::Red) {
+    return "BAD signature from " + signer_;
+  }
+  if (signature_.summary() & GpgME::Signature::KeyMissing) {
+    return "Signed by unknown key " + QString(signature_.fingerprint());
+  }
+  if (!signature_.status()) {
+    return "Good signature from " + signer_ +
+           ((signature_.summary() & GpgME::Signature::Valid)
+                ? QString()
+                : QString(" (untrusted key)"));
+  }
+  return "Signature error (" + QString(signature_.status().asString()) +
+         ") from " + signer_;
+}
+
+const GPGOperationResult GPGMeWrapper::decrypt(const QString &inputString_,
+                                               bool verify_) {
   GPGOperationResult result;
-  GpgME::Error err;
+  // To achieve non-volatile input for the GpgME++ decryption,
+  // we have to transform the encrypted text to a const char* buffer
+  // QString->toUtf8->constData()
+  const QByteArray bar = inputString_.toUtf8();
+  QByteArray ciphertextHash;
+  if (m_plaintextCache.isEnabled()) {
+    ciphertextHash = GPGPlaintextCache::hashCiphertext(bar);
+  }
+  // the cache knows nothing about signatures, so verifying always needs gpg
+  if (m_plaintextCache.isEnabled() && !verify_) {
+    if (m_plaintextCache.lookup(ciphertextHash, result.resultString,
+                                result.keyIDUsedForDecryption)) {
+      result.keyFound = true;
+      result.decryptionSuccess = true;
+      const int keyIndex = findKeyIndexByKeyID(result.keyIDUsedForDecryption);
+      if (keyIndex >= 0) {
+        result.fingerprintUsedForDecryption = m_keys.at(keyIndex).fingerPrint();
+      }
+      return result;
+    }
+  }
+
   GpgME::Protocol protocol = GpgME::OpenPGP;
-  unsigned int mode = 0;
   GpgME::initializeLibrary();
   auto ctx = std::unique_ptr<GpgME::Context>(
       GpgME::Context::createForProtocol(protocol));
   ctx->setArmor(true);
   ctx->setTextMode(true);
-  ctx->setKeyListMode(mode);
-  // find correct key
-  const GpgME::Key key =
-      ctx->key(fingerprint_.toUtf8().constData(), err, false);
-  if (err) {
-    result.errorMessage.append("Error finding key: " + QString(err.asString()));
-    return result;
+  if (m_passphraseProvider) {
+    m_passphraseProvider->attachTo(ctx.get());
   }
-  result.keyFound = true;
-
-  const QString::size_type length = inputString_.size();
-  // To achieve non-volatile input for the GpgME++ decryption,
-  // we have to transform the encrypted text to a const char* buffer
-  // QString->toUtf8->constData()
-  QByteArray bar = inputString_.toUtf8();
-  GpgME::Data encryptedString(bar.constData(), length, true);
+  // There is no need to look up a key before decrypting: gpg finds the
+  // secret key on its own and the DecryptionResult tells us which one
+  // it used.
+  GpgME::Data encryptedString(bar.constData(), bar.size(), false);
   GpgME::Data decryptedString;
   // attempt to decrypt
-  GpgME::DecryptionResult d_res =
-      ctx->decrypt(encryptedString, decryptedString);
-  if (d_res.error() == 0) {
-    result.decryptionSuccess = true;
-    //result.keyIDUsedForDecryption = d_res.recipient(0).shortKeyID();
-    for (auto i = 0; i < d_res.recipients().size(); ++i) {
-      result.keyIDUsedForDecryption += QString(d_res.recipients().at(i).keyID()) + QString("\n");
+  GpgME::DecryptionResult d_res;
+  GPGEngineStats::record(GPGEngineOp::Decrypt);
+  if (verify_) {
+    // decrypt and check the signature in a single pass over the data
+    const std::pair<GpgME::DecryptionResult, GpgME::VerificationResult> res =
+        ctx->decryptAndVerify(encryptedString, decryptedString);
+    d_res = res.first;
+    readVerificationResult(res.second, result);
+  } else {
+    d_res = ctx->decrypt(encryptedString, decryptedString);
+  }
+
+  const std::vector<GpgME::DecryptionResult::Recipient> recipients =
+      d_res.recipients();
+  // symmetrically encrypted messages have no recipients and need no key
+  result.keyFound = recipients.empty();
+  for (auto &recipient : recipients) {
+    const QString keyID(recipient.keyID());
+    const int keyIndex = findKeyIndexByKeyID(keyID);
+    if (!recipient.status()) {
+      // this is the recipient whose secret key was used
+      result.keyFound = true;
+      result.keyIDUsedForDecryption = keyID;
+      if (keyIndex >= 0) {
+        result.fingerprintUsedForDecryption = m_keys.at(keyIndex).fingerPrint();
+      }
+    } else if (keyIndex >= 0) {
+      result.keyFound = true;
     }
+  }
 
-  } else {
+  if (d_res.error()) {
     result.errorMessage.append(d_res.error().asString());
     return result;
   }
-
+  result.decryptionSuccess = true;
   result.resultString = QString::fromStdString(decryptedString.toString());
+  if (m_plaintextCache.isEnabled()) {
+    m_plaintextCache.insert(ciphertextHash, result.resultString,
+                            result.keyIDUsedForDecryption);
+  }
   return result;
 }
 
-const GPGOperationResult GPGMeWrapper::encryptString(
-    const QString &inputString_, const QString &fingerprint_,
-    const QString &recipientMail_, bool symmetricEncryption_,
-    bool showOnlyPrivateKeys_) {
-  GPGOperationResult result;
+GpgME::Key GPGMeWrapper::resolveRecipient(const QString &email_,
+                                          const QString &fingerprint_) {
+  const quint64 generation = keyringGeneration();
+  GpgME::Key key = m_recipientCache.lookup(email_, fingerprint_, generation);
+  if (!key.isNull()) {
+    return key;
+  }
+  // A single lookup by fingerprint is much cheaper than listing all keys
+  // for the mail address and searching the fingerprint in them.
+  GpgME::Error err;
+  GpgME::initializeLibrary();
+  auto ctx = std::unique_ptr<GpgME::Context>(
+      GpgME::Context::createForProtocol(GpgME::OpenPGP));
+  GPGEngineStats::record(GPGEngineOp::KeyLookup);
+  key = ctx->key(fingerprint_.toUtf8().constData(), err, false);
+  if (err || key.isNull()) {
+    return GpgME::Key();
+  }
+  if (!email_.isEmpty()) {
+    bool hasEmail = false;
+    for (auto &uid : key.userIDs()) {
+      if (GPGKeyDetails::sameMailAddress(QString::fromUtf8(uid.email()),
+                                         email_)) {
+        hasEmail = true;
+        break;
+      }
+    }
+    if (!hasEmail) {
+      return GpgME::Key();
+    }
+  }
+  m_recipientCache.insert(email_, fingerprint_, key, generation);
+  return key;
+}
 
-  std::vector<GpgME::Key> selectedKeys;
-  std::vector<GpgME::Key> keys = listKeys(showOnlyPrivateKeys_, recipientMail_);
-  // find first key for selected fingerprint and mail address
-  for (auto &key : keys) {
-    const QString fingerprint = QString(key.primaryFingerprint());
-    if (fingerprint == fingerprint_) {
-      result.keyFound = true;
-      selectedKeys.push_back(key);
+void GPGMeWrapper::preResolveRecentRecipients() {
+  const quint64 generation = keyringGeneration();
+  QStringList emails;
+  QStringList fingerprints;
+  for (auto &recent : m_recipientCache.recentRecipients()) {
+    const int separator = recent.indexOf(QLatin1Char(' '));
+    if (separator <= 0) {
+      continue;
+    }
+    const QString fingerprint = recent.left(separator);
+    const QString email = recent.mid(separator + 1);
+    if (m_recipientCache.lookup(email, fingerprint, generation).isNull()) {
+      emails.append(email);
+      fingerprints.append(fingerprint);
+    }
+  }
+  if (fingerprints.isEmpty()) {
+    return;
+  }
+  const QVector<std::vector<GpgME::Key>> found = lookupKeys(fingerprints);
+  for (auto i = 0; i < fingerprints.size(); ++i) {
+    for (auto &key : found.at(i)) {
+      if (emails.at(i).isEmpty() ||
+          keyMatchesPattern(key, "<" + emails.at(i) + ">")) {
+        m_recipientCache.insert(emails.at(i), fingerprints.at(i), key,
+                                generation);
+        break;
+      }
+    }
+  }
+}
+
+bool GPGMeWrapper::keyMatchesPattern(const GpgME::Key &key_,
+                                     const QString &pattern_) {
+  QString pattern = pattern_.trimmed();
+  if (pattern.startsWith(QLatin1Char('<')) &&
+      pattern.endsWith(QLatin1Char('>'))) {
+    for (auto &uid : key_.userIDs()) {
+      if (GPGKeyDetails::sameMailAddress(QString::fromUtf8(uid.email()),
+                                         pattern)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  if (pattern.startsWith(QLatin1String("0x"), Qt::CaseInsensitive)) {
+    pattern = pattern.mid(2);
+  }
+  bool isHex = pattern.size() >= 8;
+  for (auto c : pattern) {
+    const char l = c.toLatin1();
+    isHex = isHex && ((l >= '0' && l <= '9') || (l >= 'a' && l <= 'f') ||
+                      (l >= 'A' && l <= 'F'));
+  }
+  if (isHex) {
+    // fingerprints and key IDs of the primary key and all subkeys
+    for (auto &subkey : key_.subkeys()) {
+      if (QString(subkey.fingerprint()).endsWith(pattern,
+                                                 Qt::CaseInsensitive)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  for (auto &uid : key_.userIDs()) {
+    if (QString::fromUtf8(uid.id()).contains(pattern, Qt::CaseInsensitive)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+QVector<std::vector<GpgME::Key>>
+GPGMeWrapper::lookupKeys(const QStringList &patterns_) {
+  QVector<std::vector<GpgME::Key>> result(patterns_.size());
+  if (patterns_.isEmpty()) {
+    return result;
+  }
+  // gpgme wants a NULL terminated array of C strings
+  QVector<QByteArray> utf8Patterns;
+  std::vector<const char *> patterns;
+  utf8Patterns.reserve(patterns_.size());
+  for (auto &pattern : patterns_) {
+    utf8Patterns.append(pattern.trimmed().toUtf8());
+  }
+  for (auto &pattern : utf8Patterns) {
+    patterns.push_back(pattern.constData());
+  }
+  patterns.push_back(nullptr);
+
+  GpgME::Error err;
+  GpgME::initializeLibrary();
+  auto ctx = std::unique_ptr<GpgME::Context>(
+      GpgME::Context::createForProtocol(GpgME::OpenPGP));
+  ctx->setKeyListMode(0);
+  GPGEngineStats::record(GPGEngineOp::KeyLookup);
+  err = ctx->startKeyListing(patterns.data(), false);
+  if (err) {
+    return result;
+  }
+  // gpg returns the union of all matches, sort them back to the patterns
+  while (true) {
+    GpgME::Key key = ctx->nextKey(err);
+    if (err.code()) {
       break;
     }
+    for (auto i = 0; i < patterns_.size(); ++i) {
+      if (keyMatchesPattern(key, patterns_.at(i))) {
+        result[i].push_back(key);
+      }
+    }
   }
+  return result;
+}
 
+void GPGMeWrapper::cacheEncryptedPlaintext(const QString &ciphertext_,
+                                           const QString &plaintext_) {
+  // Remember what we just encrypted, so switching back to the decrypted
+  // view of this document does not need gpg.
+  if (m_plaintextCache.isEnabled()) {
+    m_plaintextCache.insert(
+        GPGPlaintextCache::hashCiphertext(ciphertext_.toUtf8()), plaintext_);
+  }
+}
+
+std::vector<GpgME::Key>
+GPGMeWrapper::resolveRecipients(const QStringList &fingerprints_) {
+  const quint64 generation = keyringGeneration();
+  std::vector<GpgME::Key> keys(fingerprints_.size());
+  QStringList missing;
+  for (auto i = 0; i < fingerprints_.size(); ++i) {
+    keys[i] = m_recipientCache.lookup(QString(), fingerprints_.at(i),
+                                      generation);
+    if (keys[i].isNull()) {
+      missing.append(fingerprints_.at(i));
+    }
+  }
+  if (!missing.isEmpty()) {
+    const QVector<std::vector<GpgME::Key>> found = lookupKeys(missing);
+    for (auto i = 0, m = 0; i < fingerprints_.size(); ++i) {
+      if (!keys[i].isNull()) {
+        continue;
+      }
+      if (!found.at(m).empty()) {
+        keys[i] = found.at(m).front();
+        m_recipientCache.insert(QString(), fingerprints_.at(i), keys[i],
+                                generation);
+      }
+      ++m;
+    }
+  }
+  // unknown fingerprints are left out
+  keys.erase(std::remove_if(keys.begin(), keys.end(),
+                            [](const GpgME::Key &key) { return key.isNull(); }),
+             keys.end());
+  return keys;
+}
+
+GPGOperationResult
+GPGMeWrapper::encryptToKeys(const QString &inputString_,
+                            const std::vector<GpgME::Key> &keys_,
+                            bool symmetricEncryption_, bool sign_) {
+  GPGOperationResult result;
   GpgME::Error err;
   GpgME::Protocol protocol = GpgME::OpenPGP;
-  unsigned int mode = 0;
   GpgME::initializeLibrary();
   auto ctx = std::unique_ptr<GpgME::Context>(
       GpgME::Context::createForProtocol(protocol));
   ctx->setArmor(true);
   ctx->setTextMode(true);
+  // symmetric encryption and signing need a passphrase
+  if (m_passphraseProvider) {
+    m_passphraseProvider->attachTo(ctx.get());
+  }
 
-  const QString::size_type length = inputString_.size();
-  QByteArray bar = inputString_.toUtf8();
-  GpgME::Data plainTextData = GpgME::Data(bar.constData(), length);
+  const QByteArray bar = inputString_.toUtf8();
+  GpgME::Data plainTextData = GpgME::Data(bar.constData(), bar.size(), false);
   GpgME::Data ciphertext;
 
   // encrypt
+  GPGEngineStats::record(GPGEngineOp::Encrypt);
   // Using EncryptionFlags::NoEncryptTo returns a NotImplemented error... so we
   // have to use AlwaysTrust :/
   GpgME::Context::EncryptionFlags flags =
       GpgME::Context::EncryptionFlags::AlwaysTrust;
+  const bool compress =
+      m_compressionMode == GPGCompressionMode::Always ||
+      (m_compressionMode == GPGCompressionMode::Automatic &&
+       !GPGEntropyEstimator::looksIncompressible(bar));
+  if (!compress) {
+    flags = static_cast<GpgME::Context::EncryptionFlags>(
+        flags | GpgME::Context::EncryptionFlags::NoCompress);
+  }
+  if (sign_) {
+    // sign and encrypt in a single pass, gpg signs with the default key
+    std::vector<GpgME::Key> recipients;
+    if (symmetricEncryption_) {
+      flags = static_cast<GpgME::Context::EncryptionFlags>(
+          flags | GpgME::Context::EncryptionFlags::Symmetric);
+    } else {
+      recipients = keys_;
+    }
+    const std::pair<GpgME::SigningResult, GpgME::EncryptionResult> res =
+        ctx->signAndEncrypt(recipients, plainTextData, ciphertext, flags);
+    if (res.first.error()) {
+      result.errorMessage.append("Signing Failed: " +
+                                 QString(res.first.error().asString()));
+      return result;
+    }
+    if (res.second.error()) {
+      result.errorMessage.append("Encryption Failed: " +
+                                 QString(res.second.error().asString()));
+      return result;
+    }
+    const std::vector<GpgME::CreatedSignature> signatures =
+        res.first.createdSignatures();
+    result.signatureFound = !signatures.empty();
+    result.signatureValid = !signatures.empty();
+    if (!signatures.empty()) {
+      result.signerFingerprint = QString(signatures.front().fingerprint());
+      result.signatureSummary = "Signed with " + result.signerFingerprint;
+    }
+    result.decryptionSuccess = true;
+    result.resultString = QString::fromStdString(ciphertext.toString());
+    cacheEncryptedPlaintext(result.resultString, inputString_);
+    return result;
+  }
   if (symmetricEncryption_) {
-    err = ctx->encryptSymmetrically(plainTextData, ciphertext);
+    if (compress) {
+      err = ctx->encryptSymmetrically(plainTextData, ciphertext);
+    } else {
+      // encryptSymmetrically() takes no flags, but encrypt() without
+      // recipients and with the Symmetric flag does the same
+      err = ctx->encrypt(std::vector<GpgME::Key>(), plainTextData, ciphertext,
+                         static_cast<GpgME::Context::EncryptionFlags>(
+                             GpgME::Context::EncryptionFlags::Symmetric |
+                             GpgME::Context::EncryptionFlags::NoCompress))
+                .error();
+    }
     if (!err) {
       result.decryptionSuccess = true;
       result.resultString = QString::fromStdString(ciphertext.toString());
+      cacheEncryptedPlaintext(result.resultString, inputString_);
       return result;
     } else {
       result.resultString.append("ERROR in syymetric encryption: " +
@@ -199,11 +712,13 @@ const GPGOperationResult GPGMeWrapper::encryptString(
       return result;
     }
   }
+  // one message for all recipients
   GpgME::EncryptionResult enRes =
-      ctx->encrypt(selectedKeys, plainTextData, ciphertext, flags);
+      ctx->encrypt(keys_, plainTextData, ciphertext, flags);
   if (enRes.error() == 0) {
     result.decryptionSuccess = true;
     result.resultString = QString::fromStdString(ciphertext.toString());
+    cacheEncryptedPlaintext(result.resultString, inputString_);
     return result;
   } else {
     result.errorMessage.append("Encryption Failed: " +
@@ -212,3 +727,60 @@ const GPGOperationResult GPGMeWrapper::encryptString(
   }
   return result;
 }
+
+const GPGOperationResult
+GPGMeWrapper::signAndEncrypt(const QString &inputString_,
+                             const QStringList &fingerprints_,
+                             bool symmetricEncryption_) {
+  std::vector<GpgME::Key> keys;
+  if (!symmetricEncryption_) {
+    keys = resolveRecipients(fingerprints_);
+    if (keys.size() != size_t(fingerprints_.size()) || keys.empty()) {
+      GPGOperationResult result;
+      result.errorMessage.append("Not all recipient keys were found.");
+      return result;
+    }
+  }
+  GPGOperationResult result =
+      encryptToKeys(inputString_, keys, symmetricEncryption_, true);
+  result.keyFound = true;
+  return result;
+}
+
+const GPGOperationResult GPGMeWrapper::encryptString(
+    const QString &inputString_, const QString &fingerprint_,
+    const QString &recipientMail_, bool symmetricEncryption_) {
+  std::vector<GpgME::Key> selectedKeys;
+  if (!symmetricEncryption_) {
+    const GpgME::Key key = resolveRecipient(recipientMail_, fingerprint_);
+    if (key.isNull()) {
+      GPGOperationResult result;
+      result.errorMessage.append("No key found for " + recipientMail_);
+      return result;
+    }
+    selectedKeys.push_back(key);
+  }
+  GPGOperationResult result =
+      encryptToKeys(inputString_, selectedKeys, symmetricEncryption_);
+  // no recipient key needed for symmetric encryption
+  result.keyFound = true;
+  if (result.decryptionSuccess && !symmetricEncryption_) {
+    m_recipientCache.touch(recipientMail_, fingerprint_);
+  }
+  return result;
+}
+
+const GPGOperationResult
+GPGMeWrapper::encryptStringToRecipients(const QString &inputString_,
+                                        const QStringList &fingerprints_) {
+  const std::vector<GpgME::Key> keys = resolveRecipients(fingerprints_);
+  if (keys.size() != size_t(fingerprints_.size()) || keys.empty()) {
+    GPGOperationResult result;
+    result.errorMessage.append("Not all recipient keys were found.");
+    return result;
+  }
+  GPGOperationResult result = encryptToKeys(inputString_, keys, false);
+  result.keyFound = true;
+  return result;
+}
+
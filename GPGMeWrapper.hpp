@@ -22,71 +22,324 @@
  * We want returned datatypes in C++/Qt types+containers.
  */
 
+#include <QHash>
+#include <QMutex>
 #include <QVector>
+#include <GPGBackend.hpp>
+#include <GPGKeyCache.hpp>
 #include <GPGKeyDetails.hpp>
+#include <GPGKeyringStamp.hpp>
+#include <GPGPassphraseProvider.hpp>
+#include <GPGPlaintextCache.hpp>
+#include <GPGRecipientCache.hpp>
+#include <GPGRecipientScanner.hpp>
 #include <gpgme++/key.h>
+#include <gpgme++/verificationresult.h>
 
-struct GPGOperationResult {
-  QString resultString;  // de- or encrypted string depending on operation
-  bool keyFound = false;
-  bool decryptionSuccess = false;
-  QString errorMessage;
-  QString keyIDUsedForDecryption;
+// Whether gpg compresses the plain text before encrypting it
+enum class GPGCompressionMode {
+  Automatic = 0,  // skip compression for incompressible looking text
+  Always = 1,     // gpg's default
+  Never = 2
 };
 
-class GPGMeWrapper {
+class GPGMeWrapper : public GPGBackend {
 private:
-  // The list of available GPG Keys
+  // All keys of the last keylisting
+  QVector<GPGKeyDetails> m_snapshot;
+
+  // The list of available GPG Keys (m_snapshot filtered by m_keyFilter)
   QVector<GPGKeyDetails> m_keys;
+  GPGKeyFilter m_keyFilter;
+
+  // Maps the 16 digit ID of every (sub)key to its index in m_keys. The
+  // IDs point into the keys' arenas, m_snapshot keeps them alive.
+  QHash<QStringView, int> m_keyIDIndex;
+
+  // optional session cache for decrypted text (disabled by default)
+  GPGPlaintextCache m_plaintextCache;
+
+  // resolved recipient keys, valid for one keyring generation
+  GPGRecipientCache m_recipientCache;
+
+  // finds the addresses of m_snapshot in documents, rebuilt on demand
+  GPGRecipientScanner m_recipientScanner;
+  bool m_recipientScannerOutdated = true;
+
+  // The gpgme keys of the last listKeySnapshot(), in the order of its
+  // details. setKeys() takes them for the recipient cache, the listing
+  // itself only carries GPGKeyDetails.
+  QMutex m_listedKeysMutex;
+  std::vector<GpgME::Key> m_listedKeys;
+
+  // snapshot of the last keylisting, for showing keys right at startup
+  GPGKeyCache m_keyCache;
+
+  // The keyring generation is bumped whenever the keyring files change
+  GPGKeyringStamp m_keyringStamp;
+  quint64 m_keyringGeneration = 0;
 
   // for convenience reasons we want to know the currently selected key from the
   // UI
   uint m_selectedKeyIndex;
 
+  GPGCompressionMode m_compressionMode = GPGCompressionMode::Automatic;
+  GPGPassphraseProvider *m_passphraseProvider = nullptr;
+
   /**
-   * @brief Gets all available GPG keys containing mail addresses
-   *        with search pattern.
-   * @param searchPattern_ The mail search pattern.
-   * @return A list of matching GpgMe::Key
+   * @brief Finds the key for a recipient, from the recipient cache if
+   *        possible or with a single key lookup otherwise.
+   * @param email_ The recipient email address. The key must have a user
+   *               ID with this address unless it is empty.
+   * @param fingerprint_ The fingerprint of the recipient key.
+   * @return The key or a null key if no matching key exists.
+   */
+  GpgME::Key resolveRecipient(const QString &email_,
+                              const QString &fingerprint_);
+
+  // resolves several recipients by fingerprint, all keys that are not
+  // cached yet with a single keylisting (see lookupKeys())
+  std::vector<GpgME::Key> resolveRecipients(const QStringList &fingerprints_);
+
+  // whether a key is one of the matches of a lookupKeys() pattern
+  static bool keyMatchesPattern(const GpgME::Key &key_,
+                                const QString &pattern_);
+
+  /**
+   * @brief Encrypts a string to all given keys in one message (or
+   *        symmetrically if symmetricEncryption_ is set). Depending on the
+   *        compression mode, compression is skipped for plain text that
+   *        looks incompressible (see GPGEntropyEstimator).
    */
-  std::vector<GpgME::Key> listKeys(bool showOnlyPrivateKeys_, const QString &searchPattern_ = "");
+  GPGOperationResult encryptToKeys(const QString &inputString_,
+                                   const std::vector<GpgME::Key> &keys_,
+                                   bool symmetricEncryption_,
+                                   bool sign_ = false);
+
+  // decrypts, and also verifies the signature if verify_ is set
+  const GPGOperationResult decrypt(const QString &inputString_, bool verify_);
+
+  // fills the signature details of a GPGOperationResult
+  void readVerificationResult(const GpgME::VerificationResult &verification_,
+                              GPGOperationResult &result_) const;
+
+  // fills m_keys and m_keyIDIndex from the snapshot
+  void applyKeyFilter();
+
+  // adds a freshly encrypted text to the plaintext cache
+  void cacheEncryptedPlaintext(const QString &ciphertext_,
+                               const QString &plaintext_);
 
 public:
   GPGMeWrapper();
 
-  ~GPGMeWrapper();
+  ~GPGMeWrapper() override;
 
   const QVector<GPGKeyDetails> &getKeys() const;
 
   size_t getNumKeys() const;
 
+  /**
+   * @brief Gets all available GPG keys containing mail addresses
+   *        with search pattern. This does not touch any wrapper state,
+   *        so it may run on a worker thread (see GPGKeyLoader).
+   * @param searchPattern_ The mail search pattern.
+   * @return A list of matching GpgMe::Key
+   */
+  static std::vector<GpgME::Key> listKeys(bool showOnlyPrivateKeys_,
+                                          const QString &searchPattern_ = "");
+
+  /**
+   * @brief Looks up several keys with one multi-pattern keylisting, i.e.
+   *        one gpg run instead of one per pattern.
+   * @param patterns_ Fingerprints, key IDs ("0x..." or plain hex), exact
+   *                  mail addresses ("<...>") or parts of a user ID.
+   * @return The matching keys of every pattern, in the order of patterns_.
+   */
+  static QVector<std::vector<GpgME::Key>>
+  lookupKeys(const QStringList &patterns_);
+
+  /**
+   * @brief Lists all public keys and all secret keys at the same time
+   *        (two gpg runs in parallel). The public keys are converted to
+   *        GPGKeyDetails while they are listed (see GPGKeyPipeline).
+   *        Like listKeys(), this may run on a worker thread.
+   * @param keys_ Receives the gpgme keys of the listing, in the same
+   *              order as its details (optional).
+   */
+  static GPGKeyListing listAllKeys(std::vector<GpgME::Key> *keys_ = nullptr);
+
+  // GPGBackend, see listAllKeys(), keeps the gpgme keys for setKeys()
+  GPGKeyListing listKeySnapshot() override;
+
+  // GPGBackend, see lookupKeys()
+  QVector<QStringList>
+  lookupKeyFingerprints(const QStringList &patterns_) override;
+
   /**
    * @brief This function reads all available keys and
    *        adds its details to the keys list.
    */
   void loadKeys(bool showOnlyPrivateKeys_, bool hideExpiredKeys_, const QString searchPattern_);
 
+  /**
+   * @brief Replaces the key snapshot with the result of listAllKeys()
+   *        (or of the listKeySnapshot() of any other backend).
+   *        The keys list is then filtered again.
+   */
+  void setKeys(const GPGKeyListing &listing_);
+
+  /**
+   * @brief Filters the key snapshot in memory, gpg is not involved.
+   * @param filter_ The new filters for getKeys().
+   */
+  void setKeyFilter(const GPGKeyFilter &filter_);
+  const GPGKeyFilter &keyFilter() const;
+
+  // all keys, regardless of the filters
+  const QVector<GPGKeyDetails> &allKeys() const;
+
+  /**
+   * @brief Replaces the key snapshot with the one from the on-disk key
+   *        cache, if there is one.
+   * @return Valid if the snapshot matches the keyring, Stale if it should
+   *         be replaced by a fresh listing soon, Missing if the keys list
+   *         was left unchanged.
+   */
+  GPGKeyCache::Status loadKeysFromCache();
+
+  // stores the key snapshot in the on-disk key cache
+  void saveKeysToCache(const GPGKeyringStamp &stamp_);
+
+  /**
+   * @brief Frees the key snapshot, the key ID index, the recipient scanner,
+   *        the resolved recipient keys and the cached plaintexts. The keys
+   *        are empty until the next setKeys() or loadKeysFromCache().
+   *        Recently used recipients and recipient sets are kept.
+   */
+  void trimMemory();
+
   /**
    * @brief This function attempts to decrypt a given input string
    *        using any of the available private keys. Will fail if the
    *        message was not encrypted to your private key.
+   *        The key that was used is looked up in the loaded keys, so no
+   *        extra keylisting is done. If the plaintext cache is enabled
+   *        and already knows this ciphertext, gpg is not used at all.
    * @param inputString_ The encrypted input string.
-   * @param fingerprint_ This is used for planning ahead when attempting
-   *                     to decrypt a message encrypted to multiple
-   *                     recipients.
    * @return The GPGOerationsResult (see above)
    */
-  const GPGOperationResult decryptString(const QString &inputString_,
-                                         const QString &fingerprint_);
+  const GPGOperationResult decryptString(const QString &inputString_) override;
 
+  /**
+   * @brief Like decryptString(), but also verifies the signatures of a
+   *        signed and encrypted message in the same gpg run.
+   *        The plaintext cache is not used for lookups here.
+   * @param inputString_ The encrypted input string.
+   * @return The GPGOerationsResult (see above) with the signature details.
+   */
+  const GPGOperationResult
+  decryptAndVerify(const QString &inputString_) override;
+
+  /**
+   * @brief Signs and encrypts a string in a single gpg run. gpg signs with
+   *        your default secret key (see "default-key" in gpg.conf).
+   * @param inputString_ The plain text.
+   * @param fingerprints_ The fingerprints of all recipient keys.
+   * @param symmetricEncryption_ Encrypt with a passphrase instead.
+   * @return The GPGOerationsResult (see above) with the signature details.
+   */
+  const GPGOperationResult signAndEncrypt(const QString &inputString_,
+                                          const QStringList &fingerprints_,
+                                          bool symmetricEncryption_ = false) override;
+
+  /**
+   * @brief Encrypts a string to the given recipient or symmetrically.
+   *        Recipients that were used before are taken from the recipient
+   *        cache, so this does no keylisting for them.
+   * @param inputString_ The plain text.
+   * @param fingerprint_ The fingerprint of the recipient key.
+   * @param recipientMail_ The recipient email address.
+   * @param symmetricEncryption_ Encrypt with a passphrase instead.
+   * @return The GPGOerationsResult (see above)
+   */
   const GPGOperationResult encryptString(const QString &inputString_,
                                          const QString &fingerprint_,
                                          const QString &recipientMail_,
-                                         bool symmetricEncryption_ = false,
-                                         bool showOnlyPrivateKeys_ = false);
+                                         bool symmetricEncryption_ = false) override;
+
+  /**
+   * @brief Encrypts a string to several recipients at once. This creates
+   *        a single message every recipient can decrypt.
+   * @param inputString_ The plain text.
+   * @param fingerprints_ The fingerprints of all recipient keys.
+   * @return The GPGOerationsResult (see above)
+   */
+  const GPGOperationResult
+  encryptStringToRecipients(const QString &inputString_,
+                            const QStringList &fingerprints_) override;
 
   bool isPreferredKey(const GPGKeyDetails d_, const QString &mailAddress_);
 
+  /**
+   * @brief Finds the keys whose mail addresses appear in a text, e.g. in
+   *        the To:/Cc: lines of a mail draft (see GPGRecipientScanner).
+   * @param text_ The document text.
+   * @return The fingerprints of the keys, in the order they are mentioned.
+   */
+  QStringList suggestRecipients(const QString &text_);
+
+  /**
+   * @brief Describes a verified signature in one line, e.g.
+   *        "Good signature from <signer_>".
+   * @param signature_ The signature from a VerificationResult.
+   * @param signer_ The name to show for the signing key.
+   */
+  static QString describeSignature(const GpgME::Signature &signature_,
+                                   const QString &signer_);
+
+  /**
+   * @brief Finds a loaded key by the 16 digit ID of its primary key or
+   *        any of its subkeys, e.g. a recipient ID from GPGPacketParser.
+   * @param keyID_ The key ID.
+   * @return The index in getKeys() or -1 if no such key is loaded.
+   */
+  int findKeyIndexByKeyID(const QString &keyID_) const;
+
+  /**
+   * @brief Returns the first loaded key able to decrypt a message
+   *        encrypted to the given recipients, i.e. one with a secret key.
+   *        Without such a key, the first matching public key.
+   * @param recipientKeyIDs_ The recipient key IDs (see GPGPacketInfo).
+   * @return The index in getKeys() or -1 if none of the keys is loaded.
+   */
+  int findKeyIndexForRecipients(const QVector<QString> &recipientKeyIDs_) const;
+
   void setSelectedKeyIndex(uint newSelectedKeyIndex);
   uint selectedKeyIndex() const;
+
+  GPGPlaintextCache &plaintextCache();
+
+  void setCompressionMode(GPGCompressionMode compressionMode_);
+  GPGCompressionMode compressionMode() const;
+
+  // decrypting and encrypting ask this for passphrases instead of
+  // pinentry (nullptr = pinentry)
+  void setPassphraseProvider(GPGPassphraseProvider *passphraseProvider_);
+  GPGPassphraseProvider *passphraseProvider() const;
+
+  GPGRecipientCache &recipientCache();
+
+  /**
+   * @brief Returns the current keyring generation. This stats the keyring
+   *        files and drops the recipient cache if they have changed.
+   */
+  quint64 keyringGeneration();
+
+  /**
+   * @brief Resolves all recently used recipients that are not cached yet
+   *        (most of them are already picked up by setKeys()) with a single
+   *        keylisting.
+   */
+  void preResolveRecentRecipients();
 };
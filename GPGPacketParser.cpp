@@ -0,0 +1,195 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGPacketParser.hpp>
+
+/// local functions
+namespace {
+
+// OpenPGP packet tags we care about
+const int tagPKESK = 1;     // Public-Key Encrypted Session Key
+const int tagSKESK = 3;     // Symmetric-Key Encrypted Session Key
+const int tagSED = 9;       // Symmetrically Encrypted Data (legacy)
+const int tagSEIPD = 18;    // Symmetrically Encrypted Integrity Protected Data
+const int tagAEAD = 20;     // AEAD Encrypted Data (draft/LibrePGP)
+
+const char armorBegin[] = "-----BEGIN PGP MESSAGE-----";
+
+QString keyIDToHex(const unsigned char *data_) {
+  return QString::fromLatin1(
+             QByteArray(reinterpret_cast<const char *>(data_), 8).toHex())
+      .toUpper();
+}
+
+} // namespace
+
+/// class functions
+QByteArray GPGPacketParser::dearmor(const QByteArray &armored_,
+                                    int maxBytes_) {
+  int pos = armored_.indexOf(armorBegin);
+  if (pos < 0) {
+    return QByteArray();
+  }
+  pos = armored_.indexOf('\n', pos);
+  if (pos < 0) {
+    return QByteArray();
+  }
+  ++pos;
+  // skip the armor headers ("Version: ...", "Comment: ...") up to the
+  // empty line in front of the base64 body
+  while (pos < armored_.size()) {
+    int eol = armored_.indexOf('\n', pos);
+    if (eol < 0) {
+      eol = armored_.size();
+    }
+    const QByteArray line = armored_.mid(pos, eol - pos).trimmed();
+    if (line.isEmpty()) {
+      pos = eol + 1;
+      break;
+    }
+    if (!line.contains(':')) {
+      // no empty line after the headers, this is already base64
+      break;
+    }
+    pos = eol + 1;
+  }
+  // collect just enough base64 characters for maxBytes_ binary bytes
+  const int maxBase64Chars = (maxBytes_ / 3 + 1) * 4;
+  QByteArray base64;
+  base64.reserve(qMin(maxBase64Chars, armored_.size() - pos));
+  bool atLineStart = true;
+  for (; pos < armored_.size() && base64.size() < maxBase64Chars; ++pos) {
+    const char c = armored_.at(pos);
+    if (atLineStart && (c == '=' || c == '-')) {
+      // CRC24 checksum line or armor tail
+      break;
+    }
+    atLineStart = (c == '\n');
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      continue;
+    }
+    base64.append(c);
+  }
+  // only decode complete base64 quadruples
+  base64.truncate(base64.size() - base64.size() % 4);
+  return QByteArray::fromBase64(base64);
+}
+
+GPGPacketInfo GPGPacketParser::parseMessageHeader(const QByteArray &message_) {
+  if (message_.isEmpty()) {
+    return GPGPacketInfo();
+  }
+  // binary OpenPGP packets always have the highest bit set
+  if (static_cast<unsigned char>(message_.at(0)) & 0x80) {
+    return parsePackets(message_);
+  }
+  return parsePackets(dearmor(message_));
+}
+
+GPGPacketInfo GPGPacketParser::parsePackets(const QByteArray &binary_) {
+  GPGPacketInfo info;
+  const unsigned char *data =
+      reinterpret_cast<const unsigned char *>(binary_.constData());
+  const qint64 size = binary_.size();
+  qint64 pos = 0;
+  while (pos < size) {
+    const unsigned char ctb = data[pos++];
+    if (!(ctb & 0x80)) {
+      break; // not a packet header
+    }
+    int tag = 0;
+    qint64 length = -1; // -1 = unknown (partial or indeterminate length)
+    if (ctb & 0x40) {
+      // new format packet header
+      tag = ctb & 0x3f;
+      if (pos >= size) {
+        break;
+      }
+      const unsigned char o1 = data[pos++];
+      if (o1 < 192) {
+        length = o1;
+      } else if (o1 < 224) {
+        if (pos >= size) {
+          break;
+        }
+        length = ((o1 - 192) << 8) + data[pos++] + 192;
+      } else if (o1 == 255) {
+        if (pos + 4 > size) {
+          break;
+        }
+        length = (qint64(data[pos]) << 24) | (data[pos + 1] << 16) |
+                 (data[pos + 2] << 8) | data[pos + 3];
+        pos += 4;
+      }
+    } else {
+      // old format packet header
+      tag = (ctb >> 2) & 0x0f;
+      const int lengthType = ctb & 0x03;
+      if (lengthType < 3) {
+        const int lengthBytes = 1 << lengthType;
+        if (pos + lengthBytes > size) {
+          break;
+        }
+        length = 0;
+        for (int i = 0; i < lengthBytes; ++i) {
+          length = (length << 8) | data[pos++];
+        }
+      }
+    }
+
+    if (tag == tagSED || tag == tagSEIPD || tag == tagAEAD) {
+      // the encrypted data follows the session key packets, we are done
+      info.isEncrypted = true;
+      break;
+    }
+    if (length < 0 || pos + length > size) {
+      // session key packets never use partial lengths, and we can not
+      // see past a truncated packet
+      break;
+    }
+    const unsigned char *body = data + pos;
+    if (tag == tagPKESK && length >= 1) {
+      info.isPublicKeyEncrypted = true;
+      if (body[0] == 3 && length >= 10) {
+        // v3: version, 8 byte key ID, algorithm, ...
+        info.recipientKeyIDs.append(keyIDToHex(body + 1));
+      } else if (body[0] == 6 && length >= 2) {
+        // v6: version, length, key version, fingerprint, ...
+        const int fprLength = body[1] - 1;
+        if (fprLength <= 0) {
+          info.recipientKeyIDs.append(QString(16, QChar('0')));
+        } else if (length >= 3 + fprLength && fprLength >= 8) {
+          // v4 key IDs are the low 64 bits of the fingerprint,
+          // v6 key IDs the high 64 bits
+          const unsigned char *fpr = body + 3;
+          info.recipientKeyIDs.append(
+              keyIDToHex(body[2] == 6 ? fpr : fpr + fprLength - 8));
+        }
+      }
+    } else if (tag == tagSKESK) {
+      info.isSymmetric = true;
+    } else if (tag != 10) {
+      // anything but a marker packet means this is not an encrypted
+      // message (e.g. a signed or compressed one)
+      break;
+    }
+    pos += length;
+  }
+  info.isEncrypted =
+      info.isEncrypted || info.isSymmetric || info.isPublicKeyEncrypted;
+  return info;
+}
@@ -0,0 +1,63 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief A minimal OpenPGP (RFC 4880/9580) packet parser.
+ * It only reads the session key packets at the head of an encrypted
+ * message to find out to which keys a message was encrypted, without
+ * starting gpg or attempting to decrypt anything.
+ */
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+struct GPGPacketInfo {
+  bool isEncrypted = false;          // an encrypted data packet was found
+  bool isSymmetric = false;          // message has a passphrase (SKESK) packet
+  bool isPublicKeyEncrypted = false; // message has at least one PKESK packet
+  QVector<QString> recipientKeyIDs;  // 16 hex digit key IDs from PKESK packets
+                                     // ("0000000000000000" = hidden recipient)
+};
+
+class GPGPacketParser {
+public:
+  // This is plenty for the session key packets of a few hundred recipients.
+  static const int maxHeaderScanSize = 256 * 1024;
+
+  /**
+   * @brief Parses the session key packets of an armored or binary message.
+   * @param message_ The message (or at least its first few kilobytes).
+   * @return The GPGPacketInfo (see above). isEncrypted is false if this
+   *         does not look like an encrypted OpenPGP message.
+   */
+  static GPGPacketInfo parseMessageHeader(const QByteArray &message_);
+
+  /**
+   * @brief Removes the ASCII armor from a "BEGIN PGP MESSAGE" block.
+   * @param armored_ The armored message.
+   * @param maxBytes_ Stop decoding after this many binary bytes.
+   * @return The binary packet data or an empty array if no armor was found.
+   */
+  static QByteArray dearmor(const QByteArray &armored_,
+                            int maxBytes_ = maxHeaderScanSize);
+
+private:
+  static GPGPacketInfo parsePackets(const QByteArray &binary_);
+};
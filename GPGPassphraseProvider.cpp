@@ -0,0 +1,355 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGPassphraseProvider.hpp>
+#include <GPGPlaintextCache.hpp>
+#include <QApplication>
+#include <QFile>
+#include <QInputDialog>
+#include <QLineEdit>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+#include <cstdlib>
+#include <cstring>
+#include <gpgme++/context.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Shared with the GUI thread, which may still show the dialog after the
+// provider is gone.
+struct GPGPassphraseProvider::Prompt {
+  QMutex mutex; // the members below
+  QWaitCondition done;
+  bool finished = false;
+  bool canceled = false;
+  bool ok = false;
+  QByteArray passphrase;
+};
+
+/// local functions
+namespace {
+
+char *mallocCopy(const char *data_, size_t length_) {
+  char *copy = static_cast<char *>(std::malloc(length_ + 1));
+  if (copy) {
+    std::memcpy(copy, data_, length_);
+    copy[length_] = '\0';
+  }
+  return copy;
+}
+
+// gpgme's hint is "<long key ID> <user ID>", the passphrase belongs to
+// the key (and for symmetric encryption there is no hint at all)
+QByteArray keyIDOf(const char *useridHint_) {
+  const QByteArray hint(useridHint_ ? useridHint_ : "");
+  const int space = hint.indexOf(' ');
+  return space < 0 ? hint : hint.left(space);
+}
+
+void wipe(QByteArray &data_) {
+  if (!data_.isEmpty()) {
+    GPGPlaintextCache::secureZero(data_.data(), size_t(data_.size()));
+  }
+  data_.clear();
+}
+
+} // namespace
+
+/// class functions
+GPGPassphraseProvider::GPGPassphraseProvider() {}
+
+GPGPassphraseProvider::~GPGPassphraseProvider() {
+  QMutexLocker locker(&m_mutex);
+  forgetAll();
+  for (auto &secret : m_secrets) {
+    munlock(secret.page, m_pageSize);
+    munmap(secret.page, m_pageSize);
+  }
+}
+
+void GPGPassphraseProvider::setPassphraseFile(const QString &fileName_) {
+  QMutexLocker locker(&m_mutex);
+  m_passphraseFile = fileName_;
+  forgetAll();
+}
+
+QString GPGPassphraseProvider::passphraseFile() const {
+  QMutexLocker locker(&m_mutex);
+  return m_passphraseFile;
+}
+
+void GPGPassphraseProvider::setDialogParent(QWidget *parent_) {
+  QMutexLocker locker(&m_mutex);
+  m_dialogParent = parent_;
+}
+
+void GPGPassphraseProvider::beginBatch() {
+  QMutexLocker locker(&m_mutex);
+  ++m_batchDepth;
+}
+
+void GPGPassphraseProvider::endBatch() {
+  QMutexLocker locker(&m_mutex);
+  if (m_batchDepth > 0 && --m_batchDepth == 0) {
+    forgetAll();
+  }
+}
+
+GPGPassphraseProvider::BatchScope::BatchScope(GPGPassphraseProvider *provider_)
+    : m_provider(provider_) {
+  if (m_provider) {
+    m_provider->beginBatch();
+  }
+}
+
+GPGPassphraseProvider::BatchScope::~BatchScope() {
+  if (m_provider) {
+    m_provider->endBatch();
+  }
+}
+
+void GPGPassphraseProvider::attachTo(GpgME::Context *ctx_) {
+  ctx_->setPinentryMode(GpgME::Context::PinentryLoopback);
+  ctx_->setPassphraseProvider(this);
+}
+
+int GPGPassphraseProvider::findSecret(const QByteArray &keyID_) const {
+  for (auto i = 0; i < m_secrets.size(); ++i) {
+    if (m_secrets.at(i).length >= 0 && m_secrets.at(i).keyID == keyID_) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int GPGPassphraseProvider::allocateSecret(const QByteArray &keyID_) {
+  int free = findSecret(keyID_);
+  for (auto i = 0; i < m_secrets.size() && free < 0; ++i) {
+    if (m_secrets.at(i).length < 0) {
+      free = i;
+    }
+  }
+  if (free >= 0) {
+    m_secrets[free].keyID = keyID_;
+    return free;
+  }
+  if (m_lockFailed || m_secrets.size() >= maxKeptPassphrases) {
+    return -1;
+  }
+  m_pageSize = size_t(sysconf(_SC_PAGESIZE));
+  void *page = mmap(nullptr, m_pageSize, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (page == MAP_FAILED) {
+    m_lockFailed = true;
+    return -1;
+  }
+  // a passphrase that might be swapped out is not kept at all
+  if (mlock(page, m_pageSize) != 0) {
+    munmap(page, m_pageSize);
+    m_lockFailed = true;
+    return -1;
+  }
+#ifdef MADV_DONTDUMP
+  madvise(page, m_pageSize, MADV_DONTDUMP);
+#endif
+  Secret secret;
+  secret.keyID = keyID_;
+  secret.page = static_cast<char *>(page);
+  m_secrets.append(secret);
+  return m_secrets.size() - 1;
+}
+
+void GPGPassphraseProvider::forget(Secret &secret_) {
+  GPGPlaintextCache::secureZero(secret_.page, m_pageSize);
+  secret_.keyID.clear();
+  secret_.length = -1;
+}
+
+void GPGPassphraseProvider::forgetAll() {
+  for (auto &secret : m_secrets) {
+    forget(secret);
+  }
+}
+
+int GPGPassphraseProvider::numKeptPassphrases() const {
+  QMutexLocker locker(&m_mutex);
+  int numKept = 0;
+  for (auto &secret : m_secrets) {
+    numKept += secret.length >= 0 ? 1 : 0;
+  }
+  return numKept;
+}
+
+bool GPGPassphraseProvider::readFile(QByteArray &passphrase_) const {
+  QFile file(m_passphraseFile);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  passphrase_ = file.readLine(maxPassphraseLength + 2);
+  while (passphrase_.endsWith('\n') || passphrase_.endsWith('\r')) {
+    passphrase_.chop(1);
+  }
+  return true;
+}
+
+bool GPGPassphraseProvider::ask(const QString &useridHint_,
+                                bool previousWasBad_,
+                                QByteArray &passphrase_) {
+  const QString label =
+      (previousWasBad_ ? QString("Wrong passphrase, please try again.\n\n")
+                       : QString()) +
+      "Passphrase for " + useridHint_ + ":";
+  auto prompt = std::make_shared<Prompt>();
+  QPointer<QWidget> dialogParent;
+  {
+    QMutexLocker locker(&m_mutex);
+    if (m_canceled) {
+      return false;
+    }
+    dialogParent = m_dialogParent;
+    m_prompt = prompt;
+  }
+  // only touches the prompt, never the provider
+  const auto showDialog = [prompt, dialogParent, label]() {
+    {
+      QMutexLocker locker(&prompt->mutex);
+      if (prompt->canceled) {
+        return;
+      }
+    }
+    bool ok = false;
+    QString text =
+        QInputDialog::getText(dialogParent.data(), "GPG Passphrase", label,
+                              QLineEdit::Password, QString(), &ok);
+    QMutexLocker locker(&prompt->mutex);
+    if (!prompt->canceled) {
+      prompt->ok = ok;
+      prompt->passphrase = text.toUtf8();
+    }
+    // the dialog's own copies are beyond reach, but not this one
+    if (!text.isEmpty()) {
+      GPGPlaintextCache::secureZero(text.data(),
+                                    size_t(text.size()) * sizeof(QChar));
+    }
+    prompt->finished = true;
+    prompt->done.wakeAll();
+  };
+  if (QThread::currentThread() == qApp->thread()) {
+    showDialog();
+  } else {
+    // Not a BlockingQueuedConnection: cancel() has to be able to wake
+    // this thread while the GUI thread waits for it.
+    QMetaObject::invokeMethod(qApp, showDialog, Qt::QueuedConnection);
+  }
+  bool ok;
+  {
+    QMutexLocker locker(&prompt->mutex);
+    while (!prompt->finished && !prompt->canceled) {
+      prompt->done.wait(&prompt->mutex);
+    }
+    ok = prompt->ok && !prompt->canceled;
+    // moved, not copied
+    passphrase_.swap(prompt->passphrase);
+  }
+  QMutexLocker locker(&m_mutex);
+  m_prompt.reset();
+  return ok;
+}
+
+void GPGPassphraseProvider::cancel() {
+  QMutexLocker locker(&m_mutex);
+  m_canceled = true;
+  if (m_prompt) {
+    QMutexLocker promptLocker(&m_prompt->mutex);
+    m_prompt->canceled = true;
+    wipe(m_prompt->passphrase);
+    m_prompt->done.wakeAll();
+  }
+}
+
+char *GPGPassphraseProvider::getPassphrase(const char *useridHint_,
+                                           const char * /*description_*/,
+                                           bool previousWasBad_,
+                                           bool &canceled_) {
+  canceled_ = false;
+  const QByteArray keyID = keyIDOf(useridHint_);
+  {
+    QMutexLocker locker(&m_mutex);
+    if (m_canceled) {
+      canceled_ = true;
+      return nullptr;
+    }
+    const int kept = findSecret(keyID);
+    if (kept >= 0 && previousWasBad_) {
+      forget(m_secrets[kept]);
+    } else if (kept >= 0) {
+      const Secret &secret = m_secrets.at(kept);
+      return mallocCopy(secret.page, size_t(secret.length));
+    }
+  }
+  // A worker waits for the dialog. The GUI thread must never wait for a
+  // worker that waits for the GUI thread, so it gives up instead.
+  if (QThread::currentThread() == qApp->thread()) {
+    if (!m_promptMutex.tryLock()) {
+      canceled_ = true;
+      return nullptr;
+    }
+  } else {
+    m_promptMutex.lock();
+  }
+  {
+    // another thread may have asked for this key while we were waiting
+    QMutexLocker locker(&m_mutex);
+    const int kept = previousWasBad_ ? -1 : findSecret(keyID);
+    if (kept >= 0) {
+      const Secret &secret = m_secrets.at(kept);
+      m_promptMutex.unlock();
+      return mallocCopy(secret.page, size_t(secret.length));
+    }
+  }
+  QByteArray passphrase;
+  const QString passphraseFile = this->passphraseFile();
+  bool ok;
+  if (!passphraseFile.isEmpty()) {
+    // a file can not do better the second time
+    ok = !previousWasBad_ && readFile(passphrase);
+  } else {
+    ok = ask(QString::fromUtf8(useridHint_ ? useridHint_ : ""),
+             previousWasBad_, passphrase);
+  }
+  if (!ok || passphrase.size() > maxPassphraseLength) {
+    wipe(passphrase);
+    m_promptMutex.unlock();
+    canceled_ = true;
+    return nullptr;
+  }
+  {
+    QMutexLocker locker(&m_mutex);
+    const int slot = m_batchDepth > 0 ? allocateSecret(keyID) : -1;
+    if (slot >= 0) {
+      Secret &secret = m_secrets[slot];
+      std::memcpy(secret.page, passphrase.constData(),
+                  size_t(passphrase.size()));
+      secret.length = passphrase.size();
+    }
+  }
+  m_promptMutex.unlock();
+  char *result = mallocCopy(passphrase.constData(), size_t(passphrase.size()));
+  wipe(passphrase);
+  return result;
+}
@@ -0,0 +1,138 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Asks for passphrases in Kate instead of through pinentry, using
+ * gpg's loopback pinentry mode (gpg-agent needs "allow-loopback-pinentry",
+ * the default since GnuPG 2.1.12).
+ *
+ * Within a batch (e.g. one encrypted folder search) the passphrase of
+ * each key is asked for once and kept in a locked memory page of its own
+ * until the batch ends. Up to maxKeptPassphrases keys are remembered.
+ * Outside of a batch, for more keys, or if a page can not be locked,
+ * every operation asks again. The pages are wiped when the batch ends.
+ *
+ * Tests can have the passphrase read from the first line of a file
+ * instead (setPassphraseFile()). The plugin itself never does.
+ */
+
+#include <QByteArray>
+#include <QMutex>
+#include <QPointer>
+#include <QString>
+#include <QVector>
+#include <QWidget>
+#include <gpgme++/interfaces/passphraseprovider.h>
+#include <memory>
+
+namespace GpgME {
+class Context;
+}
+
+class GPGPassphraseProvider : public GpgME::PassphraseProvider {
+public:
+  static const int maxPassphraseLength = 1023;
+  static const int maxKeptPassphrases = 8;
+
+  GPGPassphraseProvider();
+
+  ~GPGPassphraseProvider() override;
+
+  GPGPassphraseProvider(const GPGPassphraseProvider &) = delete;
+  GPGPassphraseProvider &operator=(const GPGPassphraseProvider &) = delete;
+
+  // for tests only: read the passphrase from here instead of asking
+  // (empty = ask)
+  void setPassphraseFile(const QString &fileName_);
+  QString passphraseFile() const;
+
+  // the dialog is shown on top of this widget
+  void setDialogParent(QWidget *parent_);
+
+  // batches nest, the passphrases are forgotten when the outermost one ends
+  void beginBatch();
+  void endBatch();
+
+  class BatchScope {
+  public:
+    explicit BatchScope(GPGPassphraseProvider *provider_);
+    ~BatchScope();
+
+    BatchScope(const BatchScope &) = delete;
+    BatchScope &operator=(const BatchScope &) = delete;
+
+  private:
+    GPGPassphraseProvider *m_provider;
+  };
+
+  // switches ctx_ to loopback pinentry with this provider
+  void attachTo(GpgME::Context *ctx_);
+
+  /**
+   * @brief Fails the request that waits for the dialog and all later ones,
+   *        without showing a dialog. Call this before waiting for threads
+   *        that may ask, the GUI thread can not show a dialog while it
+   *        waits for them.
+   */
+  void cancel();
+
+  /**
+   * @brief Called by gpgme, on any thread. The dialog is always shown on
+   *        the GUI thread, one at a time.
+   * @return A malloc()ed copy of the passphrase, gpgme wipes and frees it.
+   */
+  char *getPassphrase(const char *useridHint_, const char *description_,
+                      bool previousWasBad_, bool &canceled_) override;
+
+  // the number of keys whose passphrase is kept right now
+  int numKeptPassphrases() const;
+
+private:
+  struct Prompt; // a dialog a worker thread waits for
+
+  mutable QMutex m_mutex;        // the members below
+  QMutex m_promptMutex;          // one dialog at a time
+  QString m_passphraseFile;
+  QPointer<QWidget> m_dialogParent;
+  int m_batchDepth = 0;
+  // A kept passphrase. The pages are allocated on demand and reused by
+  // other keys after the batch.
+  struct Secret {
+    QByteArray keyID;     // the start of gpgme's user ID hint
+    char *page = nullptr; // locked
+    int length = -1;      // -1 = no passphrase kept
+  };
+  QVector<Secret> m_secrets;
+  size_t m_pageSize = 0;
+  bool m_lockFailed = false;
+  bool m_canceled = false;
+  std::shared_ptr<Prompt> m_prompt; // the one being shown, if any
+
+  // the kept passphrase of keyID_, or -1
+  int findSecret(const QByteArray &keyID_) const;
+  // a locked page for the passphrase of keyID_, or -1
+  int allocateSecret(const QByteArray &keyID_);
+  void forget(Secret &secret_);
+  void forgetAll();
+
+  // asks on the GUI thread, fills passphrase_ (wiped by the caller)
+  bool ask(const QString &useridHint_, bool previousWasBad_,
+           QByteArray &passphrase_);
+  bool readFile(QByteArray &passphrase_) const;
+};
@@ -0,0 +1,260 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGPlaintextCache.hpp>
+#include <QCryptographicHash>
+#include <algorithm>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/// class functions
+void GPGPlaintextCache::secureZero(void *data_, size_t size_) {
+  // memset() on memory that is not read afterwards may be optimized away
+  volatile unsigned char *p = static_cast<volatile unsigned char *>(data_);
+  while (size_--) {
+    *p++ = 0;
+  }
+}
+
+GPGPlaintextCache::GPGPlaintextCache(size_t maxBytes_, int timeToLiveSeconds_)
+    : m_maxBytes(maxBytes_), m_timeToLiveMs(qint64(timeToLiveSeconds_) * 1000) {
+  m_clock.start();
+}
+
+GPGPlaintextCache::~GPGPlaintextCache() {
+  QMutexLocker locker(&m_mutex);
+  releaseArena();
+}
+
+QByteArray GPGPlaintextCache::hashCiphertext(const QByteArray &ciphertext_) {
+  return QCryptographicHash::hash(ciphertext_, QCryptographicHash::Sha256);
+}
+
+bool GPGPlaintextCache::lookup(const QByteArray &ciphertextHash_,
+                               QString &plaintext_, QString &keyID_) {
+  QMutexLocker locker(&m_mutex);
+  if (!m_enabled || m_entries.isEmpty()) {
+    return false;
+  }
+  evictExpired();
+  for (auto i = 0; i < m_entries.size(); ++i) {
+    if (m_entries.at(i).hash != ciphertextHash_) {
+      continue;
+    }
+    Entry e = m_entries.takeAt(i);
+    e.lastUsed = m_clock.elapsed();
+    plaintext_ = QString(reinterpret_cast<const QChar *>(m_arena + e.offset),
+                         int(e.size / sizeof(QChar)));
+    keyID_ = e.keyID;
+    m_entries.append(e);
+    return true;
+  }
+  return false;
+}
+
+void GPGPlaintextCache::insert(const QByteArray &ciphertextHash_,
+                               const QString &plaintext_,
+                               const QString &keyID_) {
+  QMutexLocker locker(&m_mutex);
+  const size_t size = size_t(plaintext_.size()) * sizeof(QChar);
+  if (!m_enabled || size == 0 || size > m_maxBytes) {
+    return;
+  }
+  if (!m_arena && !allocateArena()) {
+    return;
+  }
+  for (auto i = 0; i < m_entries.size(); ++i) {
+    if (m_entries.at(i).hash == ciphertextHash_) {
+      evict(i);
+      break;
+    }
+  }
+  evictExpired();
+  if (m_arenaTop + size > m_maxBytes) {
+    size_t liveBytes = 0;
+    for (auto &e : m_entries) {
+      liveBytes += e.size;
+    }
+    // drop the least recently used entries until the new one fits
+    while (liveBytes + size > m_maxBytes && !m_entries.isEmpty()) {
+      liveBytes -= m_entries.first().size;
+      evict(0);
+    }
+    compact();
+  }
+  Entry e;
+  e.hash = ciphertextHash_;
+  e.keyID = keyID_;
+  e.offset = m_arenaTop;
+  e.size = size;
+  e.insertedAt = m_clock.elapsed();
+  e.lastUsed = e.insertedAt;
+  std::memcpy(m_arena + m_arenaTop, plaintext_.constData(), size);
+  m_arenaTop += size;
+  m_entries.append(e);
+}
+
+void GPGPlaintextCache::clear() {
+  QMutexLocker locker(&m_mutex);
+  if (m_arena) {
+    secureZero(m_arena, m_arenaTop);
+  }
+  m_arenaTop = 0;
+  m_entries.clear();
+}
+
+void GPGPlaintextCache::release() {
+  QMutexLocker locker(&m_mutex);
+  releaseArena();
+}
+
+int GPGPlaintextCache::expire() {
+  QMutexLocker locker(&m_mutex);
+  return evictExpired();
+}
+
+bool GPGPlaintextCache::isEnabled() const {
+  QMutexLocker locker(&m_mutex);
+  return m_enabled;
+}
+
+void GPGPlaintextCache::setEnabled(bool enabled_) {
+  QMutexLocker locker(&m_mutex);
+  m_enabled = enabled_;
+  if (!m_enabled) {
+    releaseArena();
+  }
+}
+
+void GPGPlaintextCache::setMaxBytes(size_t maxBytes_) {
+  QMutexLocker locker(&m_mutex);
+  if (maxBytes_ == m_maxBytes) {
+    return;
+  }
+  releaseArena();
+  m_maxBytes = maxBytes_;
+  m_arenaFailed = false;
+}
+
+size_t GPGPlaintextCache::maxBytes() const {
+  QMutexLocker locker(&m_mutex);
+  return m_maxBytes;
+}
+
+void GPGPlaintextCache::setTimeToLive(int seconds_) {
+  QMutexLocker locker(&m_mutex);
+  m_timeToLiveMs = qint64(seconds_) * 1000;
+}
+
+int GPGPlaintextCache::timeToLive() const {
+  QMutexLocker locker(&m_mutex);
+  return int(m_timeToLiveMs / 1000);
+}
+
+size_t GPGPlaintextCache::usedBytes() const {
+  QMutexLocker locker(&m_mutex);
+  size_t used = 0;
+  for (auto &e : m_entries) {
+    used += e.size;
+  }
+  return used;
+}
+
+bool GPGPlaintextCache::allocateArena() {
+  if (m_arenaFailed || m_maxBytes == 0) {
+    return false;
+  }
+  const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+  m_arenaSize = (m_maxBytes + pageSize - 1) / pageSize * pageSize;
+  void *arena = mmap(nullptr, m_arenaSize, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (arena == MAP_FAILED) {
+    m_arenaFailed = true;
+    return false;
+  }
+  // Plaintext must never be swapped out. If we are not allowed to lock
+  // this much memory (see RLIMIT_MEMLOCK) we rather don't cache at all.
+  if (mlock(arena, m_arenaSize) != 0) {
+    munmap(arena, m_arenaSize);
+    m_arenaFailed = true;
+    return false;
+  }
+#ifdef MADV_DONTDUMP
+  madvise(arena, m_arenaSize, MADV_DONTDUMP);
+#endif
+  m_arena = static_cast<char *>(arena);
+  m_arenaTop = 0;
+  return true;
+}
+
+void GPGPlaintextCache::releaseArena() {
+  m_entries.clear();
+  if (m_arena) {
+    secureZero(m_arena, m_arenaTop);
+    munlock(m_arena, m_arenaSize);
+    munmap(m_arena, m_arenaSize);
+  }
+  m_arena = nullptr;
+  m_arenaTop = 0;
+}
+
+void GPGPlaintextCache::evict(int index_) {
+  const Entry &e = m_entries.at(index_);
+  secureZero(m_arena + e.offset, e.size);
+  m_entries.removeAt(index_);
+  if (m_entries.isEmpty()) {
+    m_arenaTop = 0;
+  }
+}
+
+int GPGPlaintextCache::evictExpired() {
+  const qint64 now = m_clock.elapsed();
+  int numEvicted = 0;
+  for (auto i = m_entries.size() - 1; i >= 0; --i) {
+    if (now - m_entries.at(i).insertedAt > m_timeToLiveMs) {
+      evict(i);
+      ++numEvicted;
+    }
+  }
+  return numEvicted;
+}
+
+void GPGPlaintextCache::compact() {
+  // move all entries to the front of the arena, in offset order so no
+  // entry overwrites another one that has not been moved yet
+  QVector<Entry *> byOffset;
+  byOffset.reserve(m_entries.size());
+  for (auto &e : m_entries) {
+    byOffset.append(&e);
+  }
+  std::sort(byOffset.begin(), byOffset.end(),
+            [](const Entry *a, const Entry *b) { return a->offset < b->offset; });
+  size_t top = 0;
+  for (auto e : byOffset) {
+    if (e->offset != top) {
+      std::memmove(m_arena + top, m_arena + e->offset, e->size);
+      e->offset = top;
+    }
+    top += e->size;
+  }
+  // zeroize what was left behind by the moves
+  if (top < m_arenaTop) {
+    secureZero(m_arena + top, m_arenaTop - top);
+  }
+  m_arenaTop = top;
+}
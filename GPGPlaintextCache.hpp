@@ -0,0 +1,124 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief A session cache for decrypted text, keyed by a hash of the
+ * ciphertext. The plaintext lives in a single mlock()ed arena (so it never
+ * ends up in swap) and is overwritten with zeros when it is evicted,
+ * expires or the cache is cleared.
+ */
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+class GPGPlaintextCache {
+public:
+  GPGPlaintextCache(size_t maxBytes_ = 16 * 1024 * 1024,
+                    int timeToLiveSeconds_ = 600);
+
+  ~GPGPlaintextCache();
+
+  GPGPlaintextCache(const GPGPlaintextCache &) = delete;
+  GPGPlaintextCache &operator=(const GPGPlaintextCache &) = delete;
+
+  /**
+   * @brief Creates the cache key for a ciphertext.
+   * @param ciphertext_ The encrypted data.
+   * @return A SHA-256 hash of the ciphertext.
+   */
+  static QByteArray hashCiphertext(const QByteArray &ciphertext_);
+
+  // overwrites memory with zeros in a way the compiler can not skip
+  static void secureZero(void *data_, size_t size_);
+
+  /**
+   * @brief Looks up the plaintext for a ciphertext hash.
+   * @param ciphertextHash_ See hashCiphertext().
+   * @param plaintext_ Receives the plaintext on a hit.
+   * @param keyID_ Receives the key ID that was used for decryption.
+   * @return true on a cache hit
+   */
+  bool lookup(const QByteArray &ciphertextHash_, QString &plaintext_,
+              QString &keyID_);
+
+  /**
+   * @brief Adds a plaintext to the cache. Does nothing if the cache is
+   *        disabled, the text is larger than the cache or the arena could
+   *        not be locked into memory.
+   */
+  void insert(const QByteArray &ciphertextHash_, const QString &plaintext_,
+              const QString &keyID_ = QString());
+
+  // zeroizes and drops all cached plaintexts
+  void clear();
+
+  // like clear(), but also unmaps the arena until the next insert
+  void release();
+
+  /**
+   * @brief Zeroizes and drops the entries older than the time to live.
+   *        Lookups and inserts do this as well, but entries that are never
+   *        touched again need someone to call this periodically.
+   * @return The number of dropped entries.
+   */
+  int expire();
+
+  bool isEnabled() const;
+  void setEnabled(bool enabled_);  // disabling also clears the cache
+
+  // changing the maximum size clears the cache
+  void setMaxBytes(size_t maxBytes_);
+  size_t maxBytes() const;
+
+  void setTimeToLive(int seconds_);
+  int timeToLive() const;
+
+  size_t usedBytes() const;
+
+private:
+  struct Entry {
+    QByteArray hash;
+    QString keyID;
+    size_t offset = 0;  // in bytes from the arena start
+    size_t size = 0;    // in bytes
+    qint64 insertedAt = 0;
+    qint64 lastUsed = 0;
+  };
+
+  mutable QMutex m_mutex;
+  bool m_enabled = false;
+  size_t m_maxBytes;
+  qint64 m_timeToLiveMs;
+  QElapsedTimer m_clock;
+
+  char *m_arena = nullptr;  // allocated on first insert
+  size_t m_arenaSize = 0;   // m_maxBytes rounded up to full pages
+  bool m_arenaFailed = false;
+  size_t m_arenaTop = 0;    // bump pointer
+  QVector<Entry> m_entries; // in least recently used order
+
+  bool allocateArena();
+  void releaseArena();
+  void evict(int index_);
+  int evictExpired();
+  void compact();
+};
@@ -0,0 +1,99 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGKeyDetails.hpp>
+#include <GPGRecipientCache.hpp>
+
+GPGRecipientCache::GPGRecipientCache() {}
+
+QString GPGRecipientCache::cacheKey(const QString &email_,
+                                    const QString &fingerprint_) {
+  return fingerprint_.toUpper() + QLatin1Char(' ') +
+         GPGKeyDetails::normalizedMailAddress(email_);
+}
+
+GpgME::Key GPGRecipientCache::lookup(const QString &email_,
+                                     const QString &fingerprint_,
+                                     quint64 generation_) const {
+  auto it = m_entries.constFind(cacheKey(email_, fingerprint_));
+  if (it == m_entries.constEnd() || it->generation != generation_) {
+    return GpgME::Key();
+  }
+  return it->key;
+}
+
+void GPGRecipientCache::insert(const QString &email_,
+                               const QString &fingerprint_,
+                               const GpgME::Key &key_, quint64 generation_) {
+  Entry e;
+  e.key = key_;
+  e.generation = generation_;
+  m_entries.insert(cacheKey(email_, fingerprint_), e);
+}
+
+void GPGRecipientCache::clear() {
+  m_entries.clear();
+}
+
+int GPGRecipientCache::size() const { return m_entries.size(); }
+
+void GPGRecipientCache::touch(const QString &email_,
+                              const QString &fingerprint_) {
+  const QString entry = cacheKey(email_, fingerprint_);
+  m_recentRecipients.removeAll(entry);
+  m_recentRecipients.prepend(entry);
+  while (m_recentRecipients.size() > maxRecentRecipients) {
+    m_recentRecipients.removeLast();
+  }
+}
+
+const QStringList &GPGRecipientCache::recentRecipients() const {
+  return m_recentRecipients;
+}
+
+void GPGRecipientCache::setRecentRecipients(
+    const QStringList &recentRecipients_) {
+  m_recentRecipients = recentRecipients_.mid(0, maxRecentRecipients);
+}
+
+bool GPGRecipientCache::isRecentFingerprint(const QString &fingerprint_) const {
+  const QString prefix = fingerprint_.toUpper() + QLatin1Char(' ');
+  for (auto &entry : m_recentRecipients) {
+    if (entry.startsWith(prefix)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void GPGRecipientCache::setRecipientSet(const QString &name_,
+                                        const QStringList &fingerprints_) {
+  m_recipientSets.insert(name_, fingerprints_);
+}
+
+void GPGRecipientCache::removeRecipientSet(const QString &name_) {
+  m_recipientSets.remove(name_);
+}
+
+QStringList GPGRecipientCache::recipientSetNames() const {
+  return m_recipientSets.keys();
+}
+
+QStringList
+GPGRecipientCache::recipientSetFingerprints(const QString &name_) const {
+  return m_recipientSets.value(name_);
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Remembers which GpgME::Key belongs to an (email, fingerprint)
+ * recipient, so encrypting to a known recipient needs no keylisting.
+ * Every entry is tagged with the keyring generation it was resolved in
+ * and is ignored once the keyring has changed.
+ * The cache also keeps a most recently used list of recipients, which is
+ * stored in the plugin settings and resolved ahead of time on startup,
+ * and named recipient sets. The keys of a set are resolved like any other
+ * recipient, by fingerprint.
+ */
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <gpgme++/key.h>
+
+class GPGRecipientCache {
+public:
+  static const int maxRecentRecipients = 10;
+
+  GPGRecipientCache();
+
+  /**
+   * @brief Looks up a recipient key.
+   * @return The key or a null key if it is unknown or stale.
+   */
+  GpgME::Key lookup(const QString &email_, const QString &fingerprint_,
+                    quint64 generation_) const;
+
+  void insert(const QString &email_, const QString &fingerprint_,
+              const GpgME::Key &key_, quint64 generation_);
+
+  void clear();
+
+  int size() const;
+
+  // moves a recipient to the front of the most recently used list
+  void touch(const QString &email_, const QString &fingerprint_);
+
+  /**
+   * @brief The most recently used recipients, newest first.
+   *        Each entry is "<fingerprint> <email>".
+   */
+  const QStringList &recentRecipients() const;
+  void setRecentRecipients(const QStringList &recentRecipients_);
+
+  // true if the fingerprint is part of the most recently used list
+  bool isRecentFingerprint(const QString &fingerprint_) const;
+
+  // adds or replaces a named recipient set
+  void setRecipientSet(const QString &name_, const QStringList &fingerprints_);
+  void removeRecipientSet(const QString &name_);
+  QStringList recipientSetNames() const;  // sorted by name
+  QStringList recipientSetFingerprints(const QString &name_) const;
+
+private:
+  struct Entry {
+    GpgME::Key key;
+    quint64 generation = 0;
+  };
+
+  QHash<QString, Entry> m_entries;
+  QStringList m_recentRecipients;
+  QMap<QString, QStringList> m_recipientSets;  // name -> fingerprints
+
+  static QString cacheKey(const QString &email_, const QString &fingerprint_);
+};
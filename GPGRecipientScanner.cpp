@@ -0,0 +1,166 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGRecipientScanner.hpp>
+#include <QQueue>
+#include <QSet>
+
+/// local functions
+// characters that may be part of a mail address next to a match
+bool isAddressChar(QChar c_) {
+  return c_.isLetterOrNumber() || c_ == QLatin1Char('.') ||
+         c_ == QLatin1Char('_') || c_ == QLatin1Char('%') ||
+         c_ == QLatin1Char('+') || c_ == QLatin1Char('-') ||
+         c_ == QLatin1Char('@');
+}
+
+quint64 edgeKey(int node_, ushort c_) {
+  return (quint64(node_) << 16) | c_;
+}
+
+/// class functions
+GPGRecipientScanner::GPGRecipientScanner() { clear(); }
+
+void GPGRecipientScanner::clear() {
+  m_nodes.clear();
+  m_nodes.append(Node()); // the root
+  m_edges.clear();
+  m_addresses.clear();
+}
+
+bool GPGRecipientScanner::isEmpty() const { return m_addresses.isEmpty(); }
+
+int GPGRecipientScanner::child(int node_, ushort c_) const {
+  return m_edges.value(edgeKey(node_, c_), -1);
+}
+
+int GPGRecipientScanner::step(int node_, ushort c_) const {
+  // follow the fail links until some node can go on with c_
+  while (true) {
+    const int next = child(node_, c_);
+    if (next >= 0) {
+      return next;
+    }
+    if (node_ == 0) {
+      return 0;
+    }
+    node_ = m_nodes.at(node_).fail;
+  }
+}
+
+void GPGRecipientScanner::build(const QVector<GPGKeyDetails> &keys_) {
+  clear();
+  QHash<QString, int> addressIndex;
+  for (auto &key : keys_) {
+    if (key.isExpired()) {
+      continue;
+    }
+    for (auto &mail : key.mailAdresses()) {
+      const QString address = GPGKeyDetails::normalizedMailAddress(mail);
+      if (address.isEmpty()) {
+        continue;
+      }
+      auto index = addressIndex.find(address);
+      if (index != addressIndex.end()) {
+        if (!m_addresses[index.value()].contains(key.fingerPrint())) {
+          m_addresses[index.value()].append(key.fingerPrint());
+        }
+        continue;
+      }
+      addressIndex.insert(address, m_addresses.size());
+      // insert into the trie
+      int node = 0;
+      for (auto c : address) {
+        int next = child(node, c.unicode());
+        if (next < 0) {
+          next = m_nodes.size();
+          Node n;
+          n.depth = m_nodes.at(node).depth + 1;
+          m_nodes.append(n);
+          m_edges.insert(edgeKey(node, c.unicode()), next);
+        }
+        node = next;
+      }
+      m_nodes[node].output = m_addresses.size();
+      m_addresses.append(QStringList() << key.fingerPrint());
+    }
+  }
+
+  // breadth first: the fail link of a node only depends on shallower ones
+  QVector<QVector<QPair<ushort, int>>> children(m_nodes.size());
+  for (auto edge = m_edges.constBegin(); edge != m_edges.constEnd(); ++edge) {
+    children[int(edge.key() >> 16)].append(
+        qMakePair(ushort(edge.key() & 0xffff), edge.value()));
+  }
+  QQueue<int> queue;
+  for (auto &c : children.at(0)) {
+    m_nodes[c.second].fail = 0;
+    queue.enqueue(c.second);
+  }
+  while (!queue.isEmpty()) {
+    const int node = queue.dequeue();
+    for (auto &c : children.at(node)) {
+      const int fail = step(m_nodes.at(node).fail, c.first);
+      m_nodes[c.second].fail = fail;
+      m_nodes[c.second].dictSuffix =
+          m_nodes.at(fail).output >= 0 ? fail : m_nodes.at(fail).dictSuffix;
+      queue.enqueue(c.second);
+    }
+  }
+}
+
+QStringList GPGRecipientScanner::scan(const QString &text_) const {
+  QStringList fingerprints;
+  if (isEmpty()) {
+    return fingerprints;
+  }
+  // Folded as a whole, exactly like the addresses in
+  // GPGKeyDetails::normalizedMailAddress(). Folding code unit by code unit
+  // would differ for surrogate pairs and characters whose folded form has
+  // another length.
+  const QString text = text_.toCaseFolded();
+  QSet<QString> seen;
+  int node = 0;
+  for (auto i = 0; i < text.size(); ++i) {
+    node = step(node, text.at(i).unicode());
+    // all addresses ending at i: this node and its dictionary suffixes
+    for (int match = m_nodes.at(node).output >= 0
+                         ? node
+                         : m_nodes.at(node).dictSuffix;
+         match >= 0; match = m_nodes.at(match).dictSuffix) {
+      const int start = i - m_nodes.at(match).depth + 1;
+      if (start > 0 && isAddressChar(text.at(start - 1))) {
+        continue; // part of a longer address
+      }
+      // a dot right after the address may just end the sentence
+      int end = i + 1;
+      if (end < text.size() && text.at(end) == QLatin1Char('.')) {
+        ++end;
+      }
+      if (end < text.size() && isAddressChar(text.at(end))) {
+        continue;
+      }
+      for (auto &fingerprint : m_addresses.at(m_nodes.at(match).output)) {
+        if (!seen.contains(fingerprint)) {
+          seen.insert(fingerprint);
+          fingerprints.append(fingerprint);
+        }
+      }
+    }
+  }
+  return fingerprints;
+}
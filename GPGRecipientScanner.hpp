@@ -0,0 +1,73 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Finds the mail addresses of known keys in a text, e.g. the
+ * To:/Cc: lines of a mail draft. All addresses of the key snapshot are
+ * put into one Aho-Corasick automaton, so a document is scanned once in
+ * linear time no matter how many keys there are. Matching ignores case,
+ * and only whole addresses count ("bob@example.org" is not found in
+ * "jimbob@example.org").
+ */
+
+#include <GPGKeyDetails.hpp>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class GPGRecipientScanner {
+public:
+  GPGRecipientScanner();
+
+  /**
+   * @brief Builds the automaton for the mail addresses of the given keys.
+   *        Expired keys are left out.
+   */
+  void build(const QVector<GPGKeyDetails> &keys_);
+
+  // drops the automaton
+  void clear();
+
+  bool isEmpty() const;
+
+  /**
+   * @brief Scans a text for known mail addresses.
+   * @param text_ The text, e.g. the whole document.
+   * @return The fingerprints of all keys with an address in the text, in
+   *         the order they are first mentioned.
+   */
+  QStringList scan(const QString &text_) const;
+
+private:
+  struct Node {
+    int fail = 0;         // longest proper suffix that is also in the trie
+    int output = -1;      // index in m_addresses ending here, or -1
+    int dictSuffix = -1;  // next node on the fail chain with an output
+    int depth = 0;
+  };
+
+  QVector<Node> m_nodes;
+  // transitions, keyed by (node << 16) | case folded UTF-16 code unit
+  QHash<quint64, int> m_edges;
+  // the fingerprints of all keys with that address
+  QVector<QStringList> m_addresses;
+
+  int child(int node_, ushort c_) const;
+  int step(int node_, ushort c_) const;
+};
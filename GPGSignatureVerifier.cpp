@@ -0,0 +1,285 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGEngineStats.hpp>
+#include <GPGMeWrapper.hpp>
+#include <GPGSignatureVerifier.hpp>
+#include <QCryptographicHash>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QThread>
+#include <QVector>
+#include <cerrno>
+#include <cstdio>
+#include <gpgme++/context.h>
+#include <gpgme++/data.h>
+#include <gpgme++/interfaces/dataprovider.h>
+#include <gpgme++/verificationresult.h>
+#include <memory>
+
+/// local functions
+namespace {
+
+/**
+ * Feeds a file to gpgme in chunks and hashes exactly the bytes gpgme
+ * reads. The file is opened once, so a file replaced in the meantime can
+ * not end up with the verdict for other bytes.
+ */
+class HashingFileProvider : public GpgME::DataProvider {
+public:
+  explicit HashingFileProvider(const QString &fileName_)
+      : m_file(fileName_), m_hash(QCryptographicHash::Sha256) {
+    m_complete = m_file.open(QIODevice::ReadOnly);
+  }
+
+  bool isOpen() const { return m_file.isOpen(); }
+
+  // hashes the whole file and rewinds it for gpgme, empty on errors
+  QByteArray hashAll() {
+    const QByteArray hash = result();
+    rewind();
+    return hash;
+  }
+
+  // the hash of the file as gpgme read it, empty if that is unknown
+  QByteArray result() {
+    // gpgme may stop reading early, the rest counts too
+    char buffer[64 * 1024];
+    while (m_complete) {
+      if (read(buffer, sizeof(buffer)) <= 0) {
+        break;
+      }
+    }
+    return m_complete ? m_hash.result() : QByteArray();
+  }
+
+  bool isSupported(Operation op_) const override { return op_ != Write; }
+
+  ssize_t read(void *buffer_, size_t bufSize_) override {
+    const qint64 n =
+        m_file.read(static_cast<char *>(buffer_), qint64(bufSize_));
+    if (n < 0) {
+      m_complete = false;
+      errno = EIO;
+      return -1;
+    }
+    m_hash.addData(static_cast<const char *>(buffer_), int(n));
+    return ssize_t(n);
+  }
+
+  ssize_t write(const void * /*buffer_*/, size_t /*bufSize_*/) override {
+    errno = EBADF;
+    return -1;
+  }
+
+  off_t seek(off_t offset_, int whence_) override {
+    if (whence_ == SEEK_CUR && offset_ == 0) {
+      return off_t(m_file.pos());
+    }
+    if (whence_ == SEEK_SET && offset_ == 0) {
+      return rewind() ? 0 : -1;
+    }
+    // skipped or repeated bytes would not be hashed as read
+    m_complete = false;
+    const qint64 pos = whence_ == SEEK_SET   ? offset_
+                       : whence_ == SEEK_CUR ? m_file.pos() + offset_
+                                             : m_file.size() + offset_;
+    if (!m_file.seek(pos)) {
+      errno = EINVAL;
+      return -1;
+    }
+    return off_t(pos);
+  }
+
+  void release() override {}
+
+private:
+  QFile m_file;
+  QCryptographicHash m_hash;
+  bool m_complete; // every byte was hashed in order
+
+  bool rewind() {
+    m_hash.reset();
+    m_complete = m_file.isOpen() && m_file.seek(0);
+    return m_complete;
+  }
+};
+
+} // namespace
+
+/// class functions
+GPGSignatureVerifier::GPGSignatureVerifier(QObject *parent_)
+    : QObject(parent_) {
+  // gpg is I/O and process bound, a few parallel runs are enough to keep
+  // the gpg-agent busy without flooding the machine with processes
+  m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), 4));
+}
+
+GPGSignatureVerifier::~GPGSignatureVerifier() {
+  cancel();
+  m_pool.waitForDone();
+}
+
+bool GPGSignatureVerifier::isRunning() const {
+  return m_remaining.loadRelaxed() > 0;
+}
+
+void GPGSignatureVerifier::cancel() { m_canceled.storeRelaxed(1); }
+
+int GPGSignatureVerifier::verifyFolder(const QString &folder_,
+                                       quint64 keyringGeneration_) {
+  if (isRunning()) {
+    return -1;
+  }
+  // collect the (signed file, signature) pairs first, so we know when
+  // the last one is done
+  QVector<QPair<QString, QString>> files;
+  QDirIterator it(folder_, QStringList() << "*.sig" << "*.asc", QDir::Files,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    const QString signatureFile = it.next();
+    const QString signedFile =
+        signatureFile.left(signatureFile.lastIndexOf(QLatin1Char('.')));
+    // an .asc file without a file next to it is not a detached signature
+    if (QFileInfo(signedFile).isFile()) {
+      files.append(qMakePair(signedFile, signatureFile));
+    }
+  }
+  {
+    // results of other keyring generations are never used again
+    QMutexLocker locker(&m_cacheMutex);
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+      if (it->keyringGeneration != keyringGeneration_) {
+        it = m_cache.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+  m_numFiles = files.size();
+  m_remaining.storeRelaxed(files.size());
+  m_numValid.storeRelaxed(0);
+  m_numFromCache.storeRelaxed(0);
+  m_canceled.storeRelaxed(0);
+  if (files.isEmpty()) {
+    emit finished(0, 0, 0);
+    return 0;
+  }
+  GpgME::initializeLibrary();
+  const GPGEngineStats::Action action = GPGEngineStats::currentAction();
+  for (auto &file : files) {
+    const QString signedFile = file.first;
+    const QString signatureFile = file.second;
+    m_pool.start(
+        [this, signedFile, signatureFile, keyringGeneration_, action]() {
+          GPGEngineStats::ActionScope scope(action);
+          verifyFile(signedFile, signatureFile, keyringGeneration_);
+        });
+  }
+  return files.size();
+}
+
+void GPGSignatureVerifier::verifyFile(const QString &signedFile_,
+                                      const QString &signatureFile_,
+                                      quint64 keyringGeneration_) {
+  if (m_canceled.loadRelaxed()) {
+    fileDone(false, false);
+    return;
+  }
+  HashingFileProvider signedData(signedFile_);
+  HashingFileProvider signatureData(signatureFile_);
+  {
+    // The hashes of the current content. A hit was verified with exactly
+    // these bytes.
+    const QByteArray cacheKey = signedData.hashAll() + signatureData.hashAll();
+    QMutexLocker locker(&m_cacheMutex);
+    auto cached = m_cache.constFind(cacheKey);
+    if (cached != m_cache.constEnd() &&
+        cached->keyringGeneration == keyringGeneration_) {
+      const Result result = cached.value();
+      locker.unlock();
+      emit fileVerified(signedFile_, result.valid, result.summary, true);
+      fileDone(result.valid, true);
+      return;
+    }
+  }
+
+  Result result;
+  result.keyringGeneration = keyringGeneration_;
+  QByteArray cacheKey;
+  if (!signedData.isOpen() || !signatureData.isOpen()) {
+    result.summary = "Could not open file";
+  } else {
+    auto ctx = std::unique_ptr<GpgME::Context>(
+        GpgME::Context::createForProtocol(GpgME::OpenPGP));
+    // the providers read the files in chunks instead of loading them
+    // into memory
+    const GpgME::Data signature(&signatureData);
+    const GpgME::Data signedText(&signedData);
+    GPGEngineStats::record(GPGEngineOp::Verify);
+    const GpgME::VerificationResult verification =
+        ctx->verifyDetachedSignature(signature, signedText);
+    const std::vector<GpgME::Signature> signatures =
+        verification.signatures();
+    if (verification.error()) {
+      result.summary = QString(verification.error().asString());
+    } else if (signatures.empty()) {
+      result.summary = "No signature found";
+    } else {
+      result.valid = true;
+      for (auto &sig : signatures) {
+        result.valid = result.valid && !sig.status() &&
+                       !(sig.summary() & GpgME::Signature::Red);
+        if (!result.summary.isEmpty()) {
+          result.summary += "; ";
+        }
+        result.summary +=
+            GPGMeWrapper::describeSignature(sig, QString(sig.fingerprint()));
+      }
+    }
+    const QByteArray fileHash = signedData.result();
+    const QByteArray signatureHash = signatureData.result();
+    // a file that could not be read as a whole is not worth caching
+    if (!fileHash.isEmpty() && !signatureHash.isEmpty()) {
+      cacheKey = fileHash + signatureHash;
+    }
+  }
+  if (!cacheKey.isEmpty()) {
+    QMutexLocker locker(&m_cacheMutex);
+    if (m_cache.size() >= maxCacheEntries) {
+      m_cache.clear();
+    }
+    m_cache.insert(cacheKey, result);
+  }
+  emit fileVerified(signedFile_, result.valid, result.summary, false);
+  fileDone(result.valid, false);
+}
+
+void GPGSignatureVerifier::fileDone(bool valid_, bool fromCache_) {
+  if (valid_) {
+    m_numValid.ref();
+  }
+  if (fromCache_) {
+    m_numFromCache.ref();
+  }
+  if (!m_remaining.deref()) {
+    emit finished(m_numFiles, m_numValid.loadRelaxed(),
+                  m_numFromCache.loadRelaxed());
+  }
+}
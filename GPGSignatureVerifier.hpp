@@ -0,0 +1,89 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Verifies the detached signatures (.sig/.asc next to the signed
+ * file) of a whole folder tree on a bounded pool of worker threads.
+ * Files are streamed from disk. Results are cached by the hashes of the
+ * bytes gpg actually read from the signed file and the signature, for the
+ * current keyring generation, so running it again only verifies what has
+ * changed.
+ */
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+class GPGSignatureVerifier : public QObject {
+  Q_OBJECT
+
+public:
+  explicit GPGSignatureVerifier(QObject *parent_ = nullptr);
+
+  ~GPGSignatureVerifier();
+
+  /**
+   * @brief Starts verifying all detached signatures below folder_.
+   *        Returns immediately, results are reported by the signals below.
+   * @param folder_ The folder to walk (including sub folders).
+   * @param keyringGeneration_ The current keyring generation. Cached
+   *                           results of other generations are ignored.
+   * @return The number of signatures that will be verified, or -1 if a
+   *         verification is still running.
+   */
+  int verifyFolder(const QString &folder_, quint64 keyringGeneration_);
+
+  bool isRunning() const;
+
+  // stops handing out new files, running verifications are finished
+  void cancel();
+
+signals:
+  void fileVerified(const QString &signedFile, bool valid,
+                    const QString &summary, bool fromCache);
+  void finished(int numFiles, int numValid, int numFromCache);
+
+private:
+  struct Result {
+    bool valid = false;
+    QString summary;
+    quint64 keyringGeneration = 0;
+  };
+
+  // the cache is cleared when it reaches this size
+  static const int maxCacheEntries = 100000;
+
+  QThreadPool m_pool;
+  QMutex m_cacheMutex;
+  QHash<QByteArray, Result> m_cache;
+
+  QAtomicInt m_remaining;
+  QAtomicInt m_numValid;
+  QAtomicInt m_numFromCache;
+  QAtomicInt m_canceled;
+  int m_numFiles = 0;
+
+  void verifyFile(const QString &signedFile_, const QString &signatureFile_,
+                  quint64 keyringGeneration_);
+  void fileDone(bool valid_, bool fromCache_);
+};
@@ -0,0 +1,174 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGStringArena.hpp>
+#include <QIODevice>
+#include <QtEndian>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+/// class functions
+QVector<QString> GPGStringViewList::toVector() const {
+  QVector<QString> strings;
+  strings.reserve(m_size);
+  for (auto &string : *this) {
+    strings.append(string.toString());
+  }
+  return strings;
+}
+
+GPGStringArena::GPGStringArena(size_t chunkSize_) : m_chunkSize(chunkSize_) {}
+
+GPGStringArena::~GPGStringArena() {
+  for (auto chunk : m_chunks) {
+    std::free(chunk);
+  }
+}
+
+void *GPGStringArena::allocate(size_t size_, size_t alignment_) {
+  size_t padding =
+      (alignment_ - reinterpret_cast<quintptr>(m_top) % alignment_) %
+      alignment_;
+  if (padding + size_ > m_left) {
+    if (size_ > m_chunkSize / 4) {
+      // a large string gets a chunk of its own, the current one is kept
+      // for the next small strings (malloc() aligns for any type)
+      char *chunk = static_cast<char *>(std::malloc(size_));
+      if (!chunk) {
+        throw std::bad_alloc();
+      }
+      m_chunks.push_back(chunk);
+      m_allocatedBytes += size_;
+      m_usedBytes += size_;
+      return chunk;
+    }
+    char *chunk = static_cast<char *>(std::malloc(m_chunkSize));
+    if (!chunk) {
+      throw std::bad_alloc();
+    }
+    m_chunks.push_back(chunk);
+    m_allocatedBytes += m_chunkSize;
+    m_top = chunk;
+    m_left = m_chunkSize;
+    padding = 0;
+  }
+  void *result = m_top + padding;
+  m_top += padding + size_;
+  m_left -= padding + size_;
+  m_usedBytes += size_;
+  return result;
+}
+
+QStringView GPGStringArena::copy(QStringView string_) {
+  if (string_.isEmpty()) {
+    return QStringView();
+  }
+  QChar *chars = static_cast<QChar *>(
+      allocate(size_t(string_.size()) * sizeof(QChar), alignof(QChar)));
+  std::memcpy(chars, string_.data(), size_t(string_.size()) * sizeof(QChar));
+  return QStringView(chars, string_.size());
+}
+
+QStringView GPGStringArena::copyUtf8(const char *string_) {
+  if (!string_ || !*string_) {
+    return QStringView();
+  }
+  const size_t length = std::strlen(string_);
+  for (size_t i = 0; i < length; ++i) {
+    if (static_cast<unsigned char>(string_[i]) >= 0x80) {
+      // names with umlauts etc., rare enough for a temporary
+      return copy(QString::fromUtf8(string_, int(length)));
+    }
+  }
+  QChar *chars =
+      static_cast<QChar *>(allocate(length * sizeof(QChar), alignof(QChar)));
+  for (size_t i = 0; i < length; ++i) {
+    chars[i] = QChar(char16_t(string_[i]));
+  }
+  return QStringView(chars, qsizetype(length));
+}
+
+QStringView *GPGStringArena::allocateList(int size_) {
+  if (size_ <= 0) {
+    return nullptr;
+  }
+  QStringView *list = static_cast<QStringView *>(
+      allocate(size_t(size_) * sizeof(QStringView), alignof(QStringView)));
+  for (auto i = 0; i < size_; ++i) {
+    new (list + i) QStringView();
+  }
+  return list;
+}
+
+GPGStringViewList GPGStringArena::copyList(const QVector<QString> &strings_) {
+  QStringView *list = allocateList(strings_.size());
+  for (auto i = 0; i < strings_.size(); ++i) {
+    list[i] = copy(strings_.at(i));
+  }
+  return GPGStringViewList(list, strings_.size());
+}
+
+QStringView GPGStringArena::read(QDataStream &in_) {
+  quint32 numBytes = 0;
+  in_ >> numBytes;
+  if (in_.status() != QDataStream::Ok || numBytes == 0xffffffff ||
+      numBytes == 0) {
+    return QStringView(); // a null or empty string
+  }
+  // never trust a length from disk for the allocation
+  if (numBytes % 2 != 0 ||
+      (in_.device() && qint64(numBytes) > in_.device()->bytesAvailable())) {
+    in_.setStatus(QDataStream::ReadCorruptData);
+    return QStringView();
+  }
+  const int numChars = int(numBytes / 2);
+  QChar *chars = static_cast<QChar *>(allocate(numBytes, alignof(QChar)));
+  if (in_.readRawData(reinterpret_cast<char *>(chars), int(numBytes)) !=
+      int(numBytes)) {
+    in_.setStatus(QDataStream::ReadPastEnd);
+    return QStringView();
+  }
+  if (in_.byteOrder() == QDataStream::BigEndian) {
+    qFromBigEndian<quint16>(chars, numChars, chars);
+  } else {
+    qFromLittleEndian<quint16>(chars, numChars, chars);
+  }
+  return QStringView(chars, numChars);
+}
+
+GPGStringViewList GPGStringArena::readList(QDataStream &in_) {
+  quint32 size = 0;
+  in_ >> size;
+  // every string takes at least its 4 byte length
+  if (in_.status() != QDataStream::Ok ||
+      (in_.device() && qint64(size) * 4 > in_.device()->bytesAvailable())) {
+    in_.setStatus(QDataStream::ReadCorruptData);
+    return GPGStringViewList();
+  }
+  QStringView *list = allocateList(int(size));
+  for (quint32 i = 0; i < size && in_.status() == QDataStream::Ok; ++i) {
+    list[i] = read(in_);
+  }
+  return GPGStringViewList(list, int(size));
+}
+
+size_t GPGStringArena::usedBytes() const { return m_usedBytes; }
+
+size_t GPGStringArena::allocatedBytes() const { return m_allocatedBytes; }
+
+int GPGStringArena::numChunks() const { return int(m_chunks.size()); }
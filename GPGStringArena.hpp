@@ -0,0 +1,100 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief A monotonic allocator for the strings of one keylisting. All
+ * strings of a listing are copied into a few large chunks, and the keys
+ * only keep views on them. Nothing is freed one by one: the chunks go
+ * away together with the last key of the listing that holds on to the
+ * arena (see GPGKeyDetails).
+ *
+ * Not thread-safe; concurrent converters use one arena each.
+ */
+
+#include <QDataStream>
+#include <QString>
+#include <QStringView>
+#include <QVector>
+#include <vector>
+
+// a list of strings in a GPGStringArena
+class GPGStringViewList {
+public:
+  GPGStringViewList() {}
+  GPGStringViewList(const QStringView *data_, int size_)
+      : m_data(data_), m_size(size_) {}
+
+  int size() const { return m_size; }
+  bool isEmpty() const { return m_size == 0; }
+  QStringView at(int index_) const { return m_data[index_]; }
+  QStringView first() const { return m_data[0]; }
+  const QStringView *begin() const { return m_data; }
+  const QStringView *end() const { return m_data + m_size; }
+
+  // deep copies, for code that needs QStrings
+  QVector<QString> toVector() const;
+
+private:
+  const QStringView *m_data = nullptr;
+  int m_size = 0;
+};
+
+class GPGStringArena {
+public:
+  explicit GPGStringArena(size_t chunkSize_ = 64 * 1024);
+
+  ~GPGStringArena();
+
+  GPGStringArena(const GPGStringArena &) = delete;
+  GPGStringArena &operator=(const GPGStringArena &) = delete;
+
+  QStringView copy(QStringView string_);
+
+  // decodes UTF-8 (e.g. from gpgme), ASCII without a temporary QString
+  QStringView copyUtf8(const char *string_);
+
+  // room for a list that is filled with add() right after
+  QStringView *allocateList(int size_);
+
+  GPGStringViewList copyList(const QVector<QString> &strings_);
+
+  /**
+   * @brief Reads a QString the way QDataStream writes it, straight into
+   *        the arena.
+   * @return The string, or an empty view with in_'s status set on errors.
+   */
+  QStringView read(QDataStream &in_);
+
+  // reads a QVector<QString> the way QDataStream writes it
+  GPGStringViewList readList(QDataStream &in_);
+
+  size_t usedBytes() const;      // all strings and lists in the arena
+  size_t allocatedBytes() const; // all chunks
+  int numChunks() const;
+
+private:
+  size_t m_chunkSize;
+  std::vector<char *> m_chunks;
+  char *m_top = nullptr;   // free space in the last chunk
+  size_t m_left = 0;       // bytes left at m_top
+  size_t m_usedBytes = 0;
+  size_t m_allocatedBytes = 0;
+
+  void *allocate(size_t size_, size_t alignment_);
+};
@@ -0,0 +1,150 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGKeyDetails.hpp>
+#include <GPGUidDelegate.hpp>
+#include <QApplication>
+#include <QPainter>
+#include <QStyle>
+#include <cassert>
+
+/// local functions
+namespace {
+
+// the space Qt's item views keep around the text of a cell
+const int cellMargin = 3;
+
+} // namespace
+
+/// class functions
+GPGUidDelegate::GPGUidDelegate(QObject *parent_)
+    : QStyledItemDelegate(parent_) {}
+
+QStringList GPGUidDelegate::uidLines(const GPGKeyDetails &key_) {
+  assert(key_.uids().size() == key_.mailAdresses().size());
+  QStringList lines;
+  for (auto i = 0; i < key_.mailAdresses().size(); ++i) {
+    lines << key_.uids().at(i).toString() + " <" +
+                 key_.mailAdresses().at(i).toString() + "> (" +
+                 key_.subkeyIDs().at(i).toString() + ")";
+  }
+  return lines;
+}
+
+bool GPGUidDelegate::uidLinesEqual(const QStringList &lines_,
+                                   const GPGKeyDetails &key_) {
+  if (lines_.size() != key_.uids().size()) {
+    return false;
+  }
+  for (auto i = 0; i < lines_.size(); ++i) {
+    const QStringView line(lines_.at(i));
+    const QStringView parts[] = {key_.uids().at(i),
+                                 QStringView(u" <"),
+                                 key_.mailAdresses().at(i),
+                                 QStringView(u"> ("),
+                                 key_.subkeyIDs().at(i),
+                                 QStringView(u")")};
+    qsizetype size = 0;
+    for (auto &part : parts) {
+      size += part.size();
+    }
+    if (line.size() != size) {
+      return false;
+    }
+    qsizetype pos = 0;
+    for (auto &part : parts) {
+      if (line.mid(pos, part.size()) != part) {
+        return false;
+      }
+      pos += part.size();
+    }
+  }
+  return true;
+}
+
+QStringList GPGUidDelegate::visibleLines(const QStringList &lines_) {
+  if (lines_.size() <= maxVisibleLines) {
+    return lines_;
+  }
+  QStringList visible = lines_.mid(0, maxVisibleLines - 1);
+  visible << QString("... and %1 more").arg(lines_.size() - visible.size());
+  return visible;
+}
+
+int GPGUidDelegate::linesWidth(const QFontMetrics &fontMetrics_,
+                               const QStringList &lines_) {
+  int width = 0;
+  for (auto &line : visibleLines(lines_)) {
+    width = qMax(width, fontMetrics_.horizontalAdvance(line));
+  }
+  return width + 2 * cellMargin;
+}
+
+int GPGUidDelegate::rowHeight(const QFontMetrics &fontMetrics_,
+                              int numLines_) const {
+  const int numVisible = qBound(1, numLines_, maxVisibleLines);
+  return numVisible * fontMetrics_.lineSpacing() + 2 * cellMargin;
+}
+
+void GPGUidDelegate::paint(QPainter *painter_,
+                           const QStyleOptionViewItem &option_,
+                           const QModelIndex &index_) const {
+  QStyleOptionViewItem option = option_;
+  initStyleOption(&option, index_);
+  // background, selection and focus as usual, the text is drawn below
+  option.text.clear();
+  const QWidget *widget = option_.widget;
+  QStyle *style = widget ? widget->style() : QApplication::style();
+  style->drawControl(QStyle::CE_ItemViewItem, &option, painter_, widget);
+
+  const QStringList lines =
+      visibleLines(index_.data(uidLinesRole).toStringList());
+  const QRect textRect = style->subElementRect(QStyle::SE_ItemViewItemText,
+                                               &option, widget)
+                             .adjusted(cellMargin, cellMargin, -cellMargin,
+                                       -cellMargin);
+  const QPalette::ColorGroup colorGroup =
+      option.state & QStyle::State_Enabled ? QPalette::Normal
+                                           : QPalette::Disabled;
+  painter_->save();
+  painter_->setFont(option.font);
+  painter_->setPen(option.palette.color(
+      colorGroup, option.state & QStyle::State_Selected
+                      ? QPalette::HighlightedText
+                      : QPalette::Text));
+  const QFontMetrics &fm = option.fontMetrics;
+  int y = textRect.top();
+  for (auto &line : lines) {
+    if (y + fm.height() > textRect.bottom() + 1) {
+      break;
+    }
+    painter_->drawText(textRect.left(), y + fm.ascent(),
+                       fm.elidedText(line, Qt::ElideRight, textRect.width()));
+    y += fm.lineSpacing();
+  }
+  painter_->restore();
+}
+
+QSize GPGUidDelegate::sizeHint(const QStyleOptionViewItem &option_,
+                               const QModelIndex &index_) const {
+  // Not cached: Qt only asks for the rows it lays out, and at most
+  // maxVisibleLines lines of a cell are measured. The column widths of
+  // the key table come from updateColumnWidths() instead.
+  const QStringList lines = index_.data(uidLinesRole).toStringList();
+  const QFontMetrics &fm = option_.fontMetrics;
+  return QSize(linesWidth(fm, lines), rowHeight(fm, lines.size()));
+}
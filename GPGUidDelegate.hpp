@@ -0,0 +1,66 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Draws the "User IDs" column of the key table. The user IDs of a
+ * key come as a list of lines (see uidLinesRole) instead of one multi line
+ * string that Qt would have to lay out for every row. Row heights follow
+ * from the number of lines alone, and long lists are cut short with an
+ * "... and N more" line; the tooltip shows all of them.
+ */
+
+#include <QStyledItemDelegate>
+
+class GPGKeyDetails;
+
+class GPGUidDelegate : public QStyledItemDelegate {
+  Q_OBJECT
+
+public:
+  // a QStringList with one entry per user ID
+  static const int uidLinesRole = Qt::UserRole + 1;
+
+  // rows with more user IDs show maxVisibleLines - 1 and a summary line
+  static const int maxVisibleLines = 3;
+
+  explicit GPGUidDelegate(QObject *parent_ = nullptr);
+
+  // one "name <mail> (subkey ID)" line per user ID of key_
+  static QStringList uidLines(const GPGKeyDetails &key_);
+
+  // true if lines_ are the uidLines() of key_, without building them
+  static bool uidLinesEqual(const QStringList &lines_,
+                            const GPGKeyDetails &key_);
+
+  void paint(QPainter *painter_, const QStyleOptionViewItem &option_,
+             const QModelIndex &index_) const override;
+
+  QSize sizeHint(const QStyleOptionViewItem &option_,
+                 const QModelIndex &index_) const override;
+
+  // the row height for a cell with numLines_ user IDs
+  int rowHeight(const QFontMetrics &fontMetrics_, int numLines_) const;
+
+  // the column width needed for the lines of one cell
+  static int linesWidth(const QFontMetrics &fontMetrics_,
+                        const QStringList &lines_);
+
+  // the lines actually drawn for a list of user IDs
+  static QStringList visibleLines(const QStringList &lines_);
+};
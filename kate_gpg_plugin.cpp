@@ -15,14 +15,32 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <GPGDocumentUpdater.hpp>
+#include <GPGEngineStats.hpp>
 #include <GPGKeyDetails.hpp>
+#include <GPGPacketParser.hpp>
+#include <GPGUidDelegate.hpp>
 #include <KLocalizedString>
 #include <KPluginFactory>
+#include <QDir>
+#include <QEvent>
+#include <QElapsedTimer>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHash>
+#include <QHeaderView>
+#include <QInputDialog>
+#include <QItemSelection>
 #include <QLayout>
 #include <QMessageBox>
 #include <QScrollArea>
 #include <QScrollBar>
+#include <QStyle>
+#include <QSet>
+#include <QSignalBlocker>
 #include <QTableWidgetItem>
+#include <algorithm>
+#include <functional>
 #include <kate_gpg_plugin.hpp>
 
 K_PLUGIN_FACTORY_WITH_JSON(KateGPGPluginFactory, "kate_gpg_plugin.json",
@@ -32,13 +50,39 @@ QObject *KateGPGPlugin::createView(KTextEditor::MainWindow *mainWindow) {
   return new KateGPGPluginView(this, mainWindow);
 }
 
-KateGPGPluginView::~KateGPGPluginView() { savePluginSettings(); }
+KateGPGPluginView::~KateGPGPluginView() {
+  savePluginSettings();
+  // The members wait for their threads. A thread that waits for a
+  // passphrase dialog would wait for this (the GUI) thread forever.
+  if (m_encryptedSearch) {
+    m_encryptedSearch->cancel();
+  }
+  if (m_signatureVerifier) {
+    m_signatureVerifier->cancel();
+  }
+  if (m_passphraseProvider) {
+    m_passphraseProvider->cancel();
+  }
+}
 
 void KateGPGPluginView::readPluginSettings() {
   if (m_pluginSettings != nullptr) {
     m_pluginSettings->beginGroup("default");
     uint comboIndex =
         m_pluginSettings->value("selected_mail_address_index").toUInt();
+    m_gpgWrapper->recipientCache().setRecentRecipients(
+        m_pluginSettings->value("recent_recipients").toStringList());
+    const int numRecipientSets =
+        m_pluginSettings->beginReadArray("recipient_sets");
+    for (auto i = 0; i < numRecipientSets; ++i) {
+      m_pluginSettings->setArrayIndex(i);
+      m_gpgWrapper->recipientCache().setRecipientSet(
+          m_pluginSettings->value("name").toString(),
+          m_pluginSettings->value("fingerprints").toStringList());
+    }
+    m_pluginSettings->endArray();
+    updateRecipientSetComboBox(
+        m_pluginSettings->value("selected_recipient_set").toString());
     m_saveAsASCIICheckbox->setChecked(
         m_pluginSettings->value("use_ASCII_armor").toBool());
     m_symmetricEncryptioCheckbox->setChecked(
@@ -47,16 +91,30 @@ void KateGPGPluginView::readPluginSettings() {
         m_pluginSettings->value("show_only_private_keys").toBool());
     m_hideExpiredKeysCheckbox->setChecked(
         m_pluginSettings->value("hide_expired_secret_keys").toBool());
+    GPGPlaintextCache &cache = m_gpgWrapper->plaintextCache();
+    cache.setTimeToLive(
+        m_pluginSettings->value("plaintext_cache_ttl_minutes", 10).toInt() * 60);
+    cache.setMaxBytes(
+        m_pluginSettings->value("plaintext_cache_max_mb", 16).toUInt() * 1024 *
+        1024);
+    m_plaintextCacheCheckbox->setChecked(
+        m_pluginSettings->value("use_plaintext_cache").toBool());
+    m_compressionComboBox->setCurrentIndex(
+        m_pluginSettings->value("compression_mode").toInt());
+    m_signAndVerifyCheckbox->setChecked(
+        m_pluginSettings->value("sign_and_verify").toBool());
+    m_loopbackPinentryCheckbox->setChecked(
+        m_pluginSettings->value("use_loopback_pinentry").toBool());
     m_preferredEmailLineEdit->setText(
         m_pluginSettings->value("search_string").toString());
     m_selectedRowIndex = m_pluginSettings->value("selected_key_index").toUInt();
     if (m_gpgKeyTable->rowCount() > 0) {
       m_gpgKeyTable->selectRow(m_selectedRowIndex);
     }
-    if (comboIndex <= m_preferredEmailAddressComboBox->count()) {
-      m_preferredEmailAddressComboBox->setCurrentIndex(
-          m_pluginSettings->value("selected_mail_address_index").toUInt());
-    }
+    // the mail addresses are only known once the keys are shown
+    m_pendingMailAddressIndex = int(comboIndex);
+    m_idleTrimMinutes =
+        m_pluginSettings->value("idle_trim_minutes", 30).toInt();
     m_pluginSettings->endGroup();
   }
 }
@@ -75,12 +133,64 @@ void KateGPGPluginView::savePluginSettings() {
                                m_symmetricEncryptioCheckbox->isChecked());
     m_pluginSettings->setValue("show_only_private_keys", m_showOnlyPrivateKeysCheckbox->isChecked());
     m_pluginSettings->setValue("hide_expired_secret_keys", m_hideExpiredKeysCheckbox->isChecked());
+    m_pluginSettings->setValue(
+        "recent_recipients",
+        m_gpgWrapper->recipientCache().recentRecipients());
+    const GPGRecipientCache &recipientCache = m_gpgWrapper->recipientCache();
+    const QStringList recipientSetNames = recipientCache.recipientSetNames();
+    m_pluginSettings->beginWriteArray("recipient_sets",
+                                      recipientSetNames.size());
+    for (auto i = 0; i < recipientSetNames.size(); ++i) {
+      m_pluginSettings->setArrayIndex(i);
+      m_pluginSettings->setValue("name", recipientSetNames.at(i));
+      m_pluginSettings->setValue(
+          "fingerprints",
+          recipientCache.recipientSetFingerprints(recipientSetNames.at(i)));
+    }
+    m_pluginSettings->endArray();
+    m_pluginSettings->setValue("selected_recipient_set",
+                               m_recipientSetComboBox->currentIndex() > 0
+                                   ? m_recipientSetComboBox->currentText()
+                                   : QString());
+    m_pluginSettings->setValue("use_plaintext_cache",
+                               m_plaintextCacheCheckbox->isChecked());
+    m_pluginSettings->setValue("compression_mode",
+                               m_compressionComboBox->currentIndex());
+    m_pluginSettings->setValue("sign_and_verify",
+                               m_signAndVerifyCheckbox->isChecked());
+    m_pluginSettings->setValue("use_loopback_pinentry",
+                               m_loopbackPinentryCheckbox->isChecked());
+    const GPGPlaintextCache &cache = m_gpgWrapper->plaintextCache();
+    m_pluginSettings->setValue("plaintext_cache_ttl_minutes",
+                               cache.timeToLive() / 60);
+    m_pluginSettings->setValue("plaintext_cache_max_mb",
+                               uint(cache.maxBytes() / (1024 * 1024)));
+    m_pluginSettings->setValue("idle_trim_minutes", m_idleTrimMinutes);
     m_pluginSettings->endGroup();
   }
 }
 
+namespace {
+
+// measures one toolview update from construction to the end of its scope
+class GPGUpdateTimer {
+public:
+  explicit GPGUpdateTimer(qint64 &result_) : m_result(result_) {
+    m_timer.start();
+  }
+
+  ~GPGUpdateTimer() { m_result = m_timer.elapsed(); }
+
+private:
+  qint64 &m_result;
+  QElapsedTimer m_timer;
+};
+
+} // namespace
+
 KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin,
-                                     KTextEditor::MainWindow *mainwindow)
+                                     KTextEditor::MainWindow *mainwindow,
+                                     GPGBackend *backend_)
     : m_mainWindow(mainwindow) {
   m_gpgWrapper = new GPGMeWrapper();
   m_toolview.reset(m_mainWindow->createToolView(
@@ -96,6 +206,32 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin,
   // BUTTONS!
   m_gpgDecryptButton = new QPushButton("GPG DEcrypt current document");
   m_gpgEncryptButton = new QPushButton("GPG ENcrypt current document");
+  m_verifyFolderButton = new QPushButton("Verify signatures in folder...");
+  m_verifyFolderButton->setToolTip(
+      "Verifies all detached signatures (.sig/.asc next to the signed file)\n"
+      "in a folder and its sub folders. Unchanged files are not verified\n"
+      "again.");
+  m_signatureVerifier.reset(new GPGSignatureVerifier());
+  m_searchPatternLineEdit = new QLineEdit();
+  m_searchPatternLineEdit->setPlaceholderText("Search text");
+  m_searchRegExpCheckbox = new QCheckBox("Regular expression");
+  m_searchRegExpCheckbox->setChecked(false);
+  m_searchEncryptedButton =
+      new QPushButton("Search encrypted files in folder...");
+  m_searchEncryptedButton->setToolTip(
+      "Searches the content of all encrypted files (.gpg/.pgp/.asc) in a\n"
+      "folder and its sub folders. Files are only decrypted in memory,\n"
+      "no plain text is written to disk.");
+  m_encryptedSearch.reset(new GPGEncryptedSearch());
+  m_backend = backend_ ? backend_ : m_gpgWrapper;
+  m_keyLoader.reset(new GPGKeyLoader(m_backend));
+  m_idleTimer = new QTimer(this);
+  m_idleTimer->setSingleShot(true);
+  connect(m_idleTimer, SIGNAL(timeout()), this, SLOT(onToolviewIdle()));
+  m_plaintextExpiryTimer = new QTimer(this);
+  connect(m_plaintextExpiryTimer, SIGNAL(timeout()), this,
+          SLOT(onPlaintextCacheExpiry()));
+  m_toolview->installEventFilter(this);
 
   // Lots of initialization and setting parameters for Qt UI stuff
   m_verticalLayout = new QVBoxLayout(m_toolview.get());
@@ -108,6 +244,8 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin,
   m_preferredEmailAddressLabel->setSizePolicy(QSizePolicy::Expanding,
                                               QSizePolicy::Fixed);
   m_preferredEmailLineEdit = new QLineEdit(m_preferredEmailAddress);
+  // the object names are for finding the widgets in the tests
+  m_preferredEmailLineEdit->setObjectName("keyFilterLineEdit");
   m_preferredGPGKeyIDLabel =
       new QLabel("Selected GPG Key finerprint for encryption");
   m_EmailAddressSelectLabel =
@@ -129,22 +267,77 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin,
       "This is your currently selected GPG key fingerprint that will be used "
       "for encryption.");
 
+  m_recipientSetLabel = new QLabel("<b>Recipient set</b>");
+  m_recipientSetLabel->setSizePolicy(QSizePolicy::Maximum, QSizePolicy::Fixed);
+  m_recipientSetComboBox = new QComboBox();
+  m_recipientSetComboBox->setToolTip(
+      "Encrypt to a saved set of recipients.\n"
+      "\"(Selected keys)\" encrypts to all keys selected in the table below.");
+  m_saveRecipientSetButton =
+      new QPushButton("Save selected keys as recipient set...");
+  m_deleteRecipientSetButton = new QPushButton("Delete recipient set");
+  m_suggestRecipientsButton =
+      new QPushButton("Select recipients named in document");
+  m_suggestRecipientsButton->setToolTip(
+      "Selects the keys of all mail addresses found in the current\n"
+      "document, e.g. in the To: and Cc: lines of a mail draft.");
+  updateRecipientSetComboBox(QString());
+
   m_saveAsASCIICheckbox = new QCheckBox("Save as ASCII encoded (.asc/.gpg)");
   m_saveAsASCIICheckbox->setChecked(true);
 
   m_symmetricEncryptioCheckbox = new QCheckBox("Enable symmetric encryption");
   m_symmetricEncryptioCheckbox->setChecked(false);
 
+  // the item order matches GPGCompressionMode
+  m_compressionComboBox = new QComboBox();
+  m_compressionComboBox->addItem("Compression: automatic");
+  m_compressionComboBox->addItem("Compression: always");
+  m_compressionComboBox->addItem("Compression: never");
+  m_compressionComboBox->setToolTip(
+      "\"automatic\" skips compression for text that would not get\n"
+      "any smaller, e.g. base64 encoded data.");
+
   m_showOnlyPrivateKeysCheckbox = new QCheckBox(
       "Show only keys for which a private key is available");
   m_showOnlyPrivateKeysCheckbox->setChecked(false);
+  m_showOnlyPrivateKeysCheckbox->setObjectName("showOnlyPrivateKeysCheckbox");
 
   m_hideExpiredKeysCheckbox = new QCheckBox("Hide Expired Keys");
   m_hideExpiredKeysCheckbox->setChecked(true);
+  m_hideExpiredKeysCheckbox->setObjectName("hideExpiredKeysCheckbox");
+
+  m_signAndVerifyCheckbox =
+      new QCheckBox("Sign when encrypting, verify when decrypting");
+  m_signAndVerifyCheckbox->setChecked(false);
+  m_signAndVerifyCheckbox->setToolTip(
+      "Signs with your default secret key (\"default-key\" in gpg.conf).\n"
+      "Signing and encrypting are done in a single gpg run.");
+
+  m_loopbackPinentryCheckbox =
+      new QCheckBox("Ask for passphrases in Kate instead of pinentry");
+  m_loopbackPinentryCheckbox->setChecked(false);
+  m_loopbackPinentryCheckbox->setToolTip(
+      "Uses gpg's loopback pinentry (\"allow-loopback-pinentry\" in\n"
+      "gpg-agent.conf). A folder search asks only once and keeps the\n"
+      "passphrase in locked memory until the search is done.");
+  m_passphraseProvider.reset(new GPGPassphraseProvider());
+  m_passphraseProvider->setDialogParent(m_toolview.get());
+
+  m_plaintextCacheCheckbox =
+      new QCheckBox("Cache decrypted text for this session");
+  m_plaintextCacheCheckbox->setChecked(false);
+  m_plaintextCacheCheckbox->setToolTip(
+      "Keeps decrypted text in locked memory, so decrypting the same\n"
+      "ciphertext again does not need gpg or a password prompt.\n"
+      "Cached text is wiped when it expires or Kate is closed.");
 
   m_gpgKeyTable =
       new QTableWidget(m_gpgWrapper->getNumKeys(), 5, m_toolview.get());
   m_gpgKeyTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+  m_gpgKeyTable->setObjectName("keyTable");
+  m_uidDelegate = new GPGUidDelegate(m_gpgKeyTable);
+  m_gpgKeyTable->setItemDelegateForColumn(4, m_uidDelegate);
 
   // we want the settings stuff in QScrollArea
   QScrollArea *scrollArea = new QScrollArea(m_toolview.get());
@@ -160,18 +353,36 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin,
   m_verticalLayout->addWidget(m_titleLabel);
   m_verticalLayout->addWidget(m_gpgDecryptButton);
   m_verticalLayout->addWidget(m_gpgEncryptButton);
+  m_verticalLayout->addWidget(m_verifyFolderButton);
+  m_verticalLayout->addWidget(m_searchPatternLineEdit);
+  m_verticalLayout->addWidget(m_searchRegExpCheckbox);
+  m_verticalLayout->addWidget(m_searchEncryptedButton);
   m_verticalLayout->addWidget(m_saveAsASCIICheckbox);
   m_verticalLayout->addWidget(m_symmetricEncryptioCheckbox);
+  m_verticalLayout->addWidget(m_signAndVerifyCheckbox);
+  m_verticalLayout->addWidget(m_loopbackPinentryCheckbox);
+  m_verticalLayout->addWidget(m_plaintextCacheCheckbox);
+  m_verticalLayout->addWidget(m_compressionComboBox);
   m_verticalLayout->addWidget(m_preferredEmailAddressLabel);
   m_verticalLayout->addWidget(m_preferredEmailLineEdit);
   m_verticalLayout->addWidget(m_EmailAddressSelectLabel);
   m_verticalLayout->addWidget(m_preferredEmailAddressComboBox);
   m_verticalLayout->addWidget(m_preferredGPGKeyIDLabel);
   m_verticalLayout->addWidget(m_selectedKeyIndexEdit);
+  m_verticalLayout->addWidget(m_recipientSetLabel);
+  m_verticalLayout->addWidget(m_recipientSetComboBox);
+  m_verticalLayout->addWidget(m_saveRecipientSetButton);
+  m_verticalLayout->addWidget(m_deleteRecipientSetButton);
+  m_verticalLayout->addWidget(m_suggestRecipientsButton);
   m_verticalLayout->addWidget(m_showOnlyPrivateKeysCheckbox);
   m_verticalLayout->addWidget(m_hideExpiredKeysCheckbox);
   m_verticalLayout->addWidget(m_gpgKeyTable);
 
+  m_resultsBrowser = new QTextBrowser();
+  m_resultsBrowser->setMaximumHeight(200);
+  m_resultsBrowser->hide();
+  m_verticalLayout->addWidget(m_resultsBrowser);
+
   m_verticalLayout->insertStretch(-1, 1);
 
   connect(m_gpgKeyTable, SIGNAL(itemSelectionChanged()), this,
@@ -186,6 +397,35 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin,
           SIGNAL(stateChanged(int)),
           this,
           SLOT(onHideExpiredKeysChanged()));
+  connect(m_plaintextCacheCheckbox, SIGNAL(stateChanged(int)), this,
+          SLOT(onPlaintextCacheChanged()));
+  connect(m_compressionComboBox, SIGNAL(currentIndexChanged(int)), this,
+          SLOT(onCompressionModeChanged()));
+  connect(m_saveRecipientSetButton, SIGNAL(released()), this,
+          SLOT(onSaveRecipientSetPressed()));
+  connect(m_deleteRecipientSetButton, SIGNAL(released()), this,
+          SLOT(onDeleteRecipientSetPressed()));
+  connect(m_suggestRecipientsButton, SIGNAL(released()), this,
+          SLOT(onSuggestRecipientsPressed()));
+  connect(m_verifyFolderButton, SIGNAL(released()), this,
+          SLOT(onVerifyFolderPressed()));
+  connect(m_signatureVerifier.get(),
+          SIGNAL(fileVerified(QString, bool, QString, bool)), this,
+          SLOT(onFileVerified(QString, bool, QString, bool)));
+  connect(m_signatureVerifier.get(), SIGNAL(finished(int, int, int)), this,
+          SLOT(onFolderVerificationFinished(int, int, int)));
+  connect(m_searchEncryptedButton, SIGNAL(released()), this,
+          SLOT(onSearchEncryptedPressed()));
+  connect(m_searchPatternLineEdit, SIGNAL(returnPressed()), this,
+          SLOT(onSearchEncryptedPressed()));
+  connect(m_encryptedSearch.get(), SIGNAL(matchFound(QString, int, QString)),
+          this, SLOT(onSearchMatchFound(QString, int, QString)));
+  connect(m_encryptedSearch.get(), SIGNAL(fileFailed(QString, QString)), this,
+          SLOT(onSearchFileFailed(QString, QString)));
+  connect(m_encryptedSearch.get(), SIGNAL(finished(int, int, int)), this,
+          SLOT(onSearchFinished(int, int, int)));
+  connect(m_keyLoader.get(), SIGNAL(finished(quint64)), this,
+          SLOT(onKeysListed(quint64)));
   connect(m_gpgDecryptButton, SIGNAL(released()), this,
           SLOT(decryptButtonPressed()));
   connect(m_gpgEncryptButton, SIGNAL(released()), this,
@@ -196,24 +436,230 @@ KateGPGPluginView::KateGPGPluginView(KateGPGPlugin *plugin,
   // restore plugin settings
   m_pluginSettings = new QSettings(m_settingsName);
   readPluginSettings();
+  // the settings have already scheduled the update, this is a no-op
+  // unless they left everything at its default
+  scheduleViewStateUpdate();
 }
 
-void KateGPGPluginView::onPreferredEmailAddressChanged(QString s_) {
-  emit m_gpgKeyTable->itemSelectionChanged();
-  m_preferredEmailAddress = m_preferredEmailLineEdit->text();
+bool GPGViewState::operator==(const GPGViewState &other_) const {
+  return keyFilter == other_.keyFilter &&
+         usePlaintextCache == other_.usePlaintextCache &&
+         compressionMode == other_.compressionMode;
+}
+
+bool GPGViewState::operator!=(const GPGViewState &other_) const {
+  return !(*this == other_);
+}
+
+GPGViewState KateGPGPluginView::currentViewState() const {
+  GPGViewState state;
+  state.keyFilter = currentKeyFilter();
+  state.usePlaintextCache = m_plaintextCacheCheckbox->isChecked();
+  state.compressionMode =
+      static_cast<GPGCompressionMode>(m_compressionComboBox->currentIndex());
+  return state;
+}
+
+void KateGPGPluginView::scheduleViewStateUpdate() {
+  noteToolviewActivity();
+  if (m_viewStateUpdateScheduled) {
+    return;
+  }
+  m_viewStateUpdateScheduled = true;
+  QMetaObject::invokeMethod(this, "applyViewState", Qt::QueuedConnection);
+}
+
+void KateGPGPluginView::noteToolviewActivity() {
+  if (m_idleTrimMinutes > 0) {
+    m_idleTimer->start(m_idleTrimMinutes * 60 * 1000);
+  } else {
+    m_idleTimer->stop();
+  }
+  if (m_keysTrimmed) {
+    // from the disk cache right away, or listed in the background
+    m_keysTrimmed = false;
+    reloadKeys();
+  }
+}
+
+void KateGPGPluginView::onToolviewIdle() {
+  if (m_keysTrimmed) {
+    return;
+  }
+  if (m_keyLoader->isRunning()) {
+    // the listing would bring everything back right away
+    noteToolviewActivity();
+    return;
+  }
+  m_trimmedSelection = selectedFingerprints();
+  m_pendingMailAddressIndex = m_preferredEmailAddressComboBox->currentIndex();
+  {
+    // emptying the table is not a selection by the user
+    const QSignalBlocker blocker(m_gpgKeyTable->selectionModel());
+    m_gpgKeyTable->setRowCount(0);
+  }
+  m_gpgWrapper->trimMemory();
+  m_keysTrimmed = true;
+}
+
+void KateGPGPluginView::onPlaintextCacheExpiry() {
+  m_gpgWrapper->plaintextCache().expire();
+}
+
+bool KateGPGPluginView::eventFilter(QObject *watched_, QEvent *event_) {
+  if (watched_ == m_toolview.get() &&
+      (event_->type() == QEvent::Show || event_->type() == QEvent::Enter)) {
+    noteToolviewActivity();
+  }
+  return QObject::eventFilter(watched_, event_);
+}
+
+GPGPassphraseProvider *KateGPGPluginView::activePassphraseProvider() const {
+  // only ever switched on by the user
+  if (m_loopbackPinentryCheckbox->isChecked()) {
+    return m_passphraseProvider.get();
+  }
+  return nullptr;
+}
+
+quint64 KateGPGPluginView::numViewStateUpdates() const {
+  return m_numViewStateUpdates;
+}
+
+GPGBackend *KateGPGPluginView::backend() const { return m_backend; }
+
+const GPGViewTimings &KateGPGPluginView::timings() const { return m_timings; }
+
+void KateGPGPluginView::applyViewState() {
+  m_viewStateUpdateScheduled = false;
+  const GPGViewState state = currentViewState();
+  if (m_viewStateApplied && state == m_viewState) {
+    return; // e.g. a checkbox toggled twice
+  }
+  ++m_numViewStateUpdates;
+  // filters and checkboxes only work on the loaded keys
+  GPGEngineStats::ActionScope scope("view state update", 0);
+  GPGUpdateTimer timer(m_timings.viewStateMs);
+  if (!m_viewStateApplied ||
+      state.usePlaintextCache != m_viewState.usePlaintextCache) {
+    m_gpgWrapper->plaintextCache().setEnabled(state.usePlaintextCache);
+    if (state.usePlaintextCache) {
+      // an entry lives at most one interval longer than its time to live
+      const int ttlMs = m_gpgWrapper->plaintextCache().timeToLive() * 1000;
+      m_plaintextExpiryTimer->start(qBound(1000, ttlMs / 4, 60 * 1000));
+    } else {
+      m_plaintextExpiryTimer->stop();
+    }
+  }
+  if (!m_viewStateApplied ||
+      state.compressionMode != m_viewState.compressionMode) {
+    m_gpgWrapper->setCompressionMode(state.compressionMode);
+  }
+  const bool firstUpdate = !m_viewStateApplied;
+  const bool keyFilterChanged =
+      firstUpdate || state.keyFilter != m_viewState.keyFilter;
+  m_viewState = state;
+  m_viewStateApplied = true;
+  if (keyFilterChanged) {
+    // the filters only select from the loaded keys, no gpg run
+    m_preferredEmailAddress = state.keyFilter.searchPattern;
+    m_gpgWrapper->setKeyFilter(state.keyFilter);
+    if (firstUpdate) {
+      reloadKeys();
+    } else {
+      showKeys();
+    }
+  }
+}
+
+GPGKeyFilter KateGPGPluginView::currentKeyFilter() const {
+  GPGKeyFilter filter;
+  filter.showOnlyPrivateKeys = m_showOnlyPrivateKeysCheckbox->isChecked();
+  filter.hideExpiredKeys = m_hideExpiredKeysCheckbox->isChecked();
+  filter.searchPattern = m_preferredEmailLineEdit->text();
+  return filter;
+}
+
+void KateGPGPluginView::reloadKeys() {
+  // the public and the secret listing, not counted for the action that
+  // asked for them (e.g. the first view state update)
+  GPGEngineStats::ActionScope scope(
+      GPGEngineStats::newAction("key reload", 2));
+  if (m_backend != m_gpgWrapper) {
+    // the disk cache only holds the gpg keyring
+    m_keyLoader->start();
+    return;
+  }
+  const GPGKeyCache::Status status = m_gpgWrapper->loadKeysFromCache();
+  if (status != GPGKeyCache::Status::Missing) {
+    showKeys();
+  }
+  if (status == GPGKeyCache::Status::Valid) {
+    return;
+  }
+  m_keyLoader->start();
+}
+
+void KateGPGPluginView::onKeysListed(quint64 requestID_) {
+  GPGKeyListing listing;
+  GPGKeyringStamp stamp;
+  if (!m_keyLoader->takeKeys(requestID_, listing, stamp)) {
+    return; // a newer listing is on its way
+  }
+  GPGUpdateTimer timer(m_timings.keysShownMs);
+  // one batched lookup for the recent recipients
+  GPGEngineStats::ActionScope scope("key listing", 1);
+  m_keysTrimmed = false;
+  m_gpgWrapper->setKeys(listing);
+  if (m_backend == m_gpgWrapper) {
+    m_gpgWrapper->saveKeysToCache(stamp);
+  }
+  showKeys();
+  // most recent recipients were just picked up by setKeys()
+  m_gpgWrapper->preResolveRecentRecipients();
+}
+
+void KateGPGPluginView::showKeys() {
+  const bool firstKeys = m_gpgKeyTable->rowCount() == 0;
+  const int savedRowIndex = m_selectedRowIndex;
   updateKeyTable();
+  // the row saved in the settings is restored once, afterwards the
+  // table keeps the user's selection by itself
+  if (!m_trimmedSelection.isEmpty()) {
+    // back after onToolviewIdle()
+    if (m_gpgKeyTable->rowCount() > 0) {
+      selectKeysByFingerprints(m_trimmedSelection);
+      m_trimmedSelection.clear();
+    }
+  } else if (firstKeys && savedRowIndex > 0 &&
+             savedRowIndex < m_gpgKeyTable->rowCount()) {
+    m_gpgKeyTable->selectRow(savedRowIndex);
+  }
+  if (m_pendingMailAddressIndex >= 0 &&
+      m_pendingMailAddressIndex < m_preferredEmailAddressComboBox->count()) {
+    m_preferredEmailAddressComboBox->setCurrentIndex(m_pendingMailAddressIndex);
+    m_pendingMailAddressIndex = -1;
+  }
+}
+
+void KateGPGPluginView::onPreferredEmailAddressChanged(QString s_) {
+  scheduleViewStateUpdate();
 }
 
 void KateGPGPluginView::onShowOnlyPrivateKeysChanged() {
-  emit m_gpgKeyTable->itemSelectionChanged();
-  m_preferredEmailAddress = m_preferredEmailLineEdit->text();
-  updateKeyTable();
+  scheduleViewStateUpdate();
 }
 
 void KateGPGPluginView::onHideExpiredKeysChanged() {
-  emit m_gpgKeyTable->itemSelectionChanged();
-  m_preferredEmailAddress = m_preferredEmailLineEdit->text();
-  updateKeyTable();
+  scheduleViewStateUpdate();
+}
+
+void KateGPGPluginView::onPlaintextCacheChanged() {
+  scheduleViewStateUpdate();
+}
+
+void KateGPGPluginView::onCompressionModeChanged() {
+  scheduleViewStateUpdate();
 }
 
 int pluginMessageBox(const QString title_, const QString msg_) {
@@ -225,6 +671,8 @@ int pluginMessageBox(const QString title_, const QString msg_) {
 }
 
 void KateGPGPluginView::decryptButtonPressed() {
+  noteToolviewActivity();
+  GPGEngineStats::ActionScope scope("decrypt");
   QList<KTextEditor::View *> views = m_mainWindow->views();
   if (views.size() < 1) {
     pluginMessageBox("Error!", "No views available...");
@@ -235,34 +683,55 @@ void KateGPGPluginView::decryptButtonPressed() {
     pluginMessageBox("Error Decrypting Text!", "Document is empty..");
     return;
   }
-  if (m_selectedKeyIndexEdit->text().isEmpty()) {
-    pluginMessageBox("Error Decrypting Text!", "No fingerprint selected...");
-    return;
-  }
-  GPGOperationResult res = m_gpgWrapper->decryptString(
-      v->document()->text(), m_selectedKeyIndexEdit->text());
-  if (!res.keyFound) {
+  const QString documentText = v->document()->text();
+  // Find out to whom this message was encrypted and select a matching key
+  // before starting gpg. Only the head of the document is needed for this.
+  const GPGPacketInfo packetInfo = GPGPacketParser::parseMessageHeader(
+      documentText.left(GPGPacketParser::maxHeaderScanSize).toUtf8());
+  if (!packetInfo.isEncrypted) {
     pluginMessageBox("Error Decrypting Text!",
-                     "No matching fingerprint found!\n"
-                     "Or this is not a GPG "
-                     "encrypted text...");
+                     "This is not a GPG encrypted text...");
     return;
   }
+  if (packetInfo.isPublicKeyEncrypted) {
+    const int keyIndex =
+        m_gpgWrapper->findKeyIndexForRecipients(packetInfo.recipientKeyIDs);
+    if (keyIndex >= 0) {
+      selectKeyByFingerprint(m_gpgWrapper->getKeys().at(keyIndex).fingerPrint());
+    }
+  }
+  const bool verify = m_signAndVerifyCheckbox->isChecked();
+  m_gpgWrapper->setPassphraseProvider(activePassphraseProvider());
+  GPGPassphraseProvider::BatchScope batch(m_gpgWrapper->passphraseProvider());
+  GPGOperationResult res = verify ? m_backend->decryptAndVerify(documentText)
+                                 : m_backend->decryptString(documentText);
   if (!res.decryptionSuccess) {
+    if (!res.keyFound) {
+      pluginMessageBox("Error Decrypting Text!",
+                       "No matching private key found!\n" + res.errorMessage);
+      return;
+    }
     pluginMessageBox("Error Decrypting Text!", res.errorMessage);
     return;
   }
-  pluginMessageBox("KeyID used for decryption:", res.keyIDUsedForDecryption);
-  for (auto i = 0; i < m_gpgWrapper->getNumKeys(); ++i) {
-    const GPGKeyDetails &kd = m_gpgWrapper->getKeys().at(i);
-    if (kd.keyID().compare(res.keyIDUsedForDecryption) == 0) {
-      pluginMessageBox("KeyID used for decryption Found!", res.keyIDUsedForDecryption);
+  if (!res.fingerprintUsedForDecryption.isEmpty()) {
+    selectKeyByFingerprint(res.fingerprintUsedForDecryption);
+  }
+  if (verify) {
+    if (!res.signatureFound) {
+      pluginMessageBox("Signature Verification", "This message is not signed.");
+    } else {
+      pluginMessageBox(res.signatureValid ? "Signature Verified"
+                                          : "Signature Verification Failed!",
+                       res.signatureSummary);
     }
   }
-  v->document()->setText(res.resultString);
+  GPGDocumentUpdater::replaceText(v->document(), res.resultString);
 }
 
 void KateGPGPluginView::encryptButtonPressed() {
+  noteToolviewActivity();
+  GPGEngineStats::ActionScope scope("encrypt");
   QList<KTextEditor::View *> views = m_mainWindow->views();
   if (views.size() < 1) {
     pluginMessageBox("Error!", "No views available...");
@@ -278,16 +747,49 @@ void KateGPGPluginView::encryptButtonPressed() {
     pluginMessageBox("Error Encrypting Text!", "Document is empty..");
     return;
   }
-  if (m_selectedKeyIndexEdit->text().isEmpty()) {
-    pluginMessageBox("Error Encrypting Text!", "No fingerprint selected...");
-    return;
+  const bool symmetric = m_symmetricEncryptioCheckbox->isChecked();
+  const QStringList fingerprints = selectedFingerprints();
+  // a recipient set is encrypted to like any other list of recipients
+  const QString recipientSet = m_recipientSetComboBox->currentIndex() > 0
+                                   ? m_recipientSetComboBox->currentText()
+                                   : QString();
+  m_gpgWrapper->setPassphraseProvider(activePassphraseProvider());
+  GPGPassphraseProvider::BatchScope batch(m_gpgWrapper->passphraseProvider());
+  GPGOperationResult res;
+  if (m_signAndVerifyCheckbox->isChecked()) {
+    QStringList recipients;
+    if (!symmetric && !recipientSet.isEmpty()) {
+      recipients = m_gpgWrapper->recipientCache().recipientSetFingerprints(
+          recipientSet);
+    } else if (!symmetric && fingerprints.size() > 1) {
+      recipients = fingerprints;
+    } else if (!symmetric) {
+      if (m_selectedKeyIndexEdit->text().isEmpty()) {
+        pluginMessageBox("Error Encrypting Text!", "No fingerprint selected...");
+        return;
+      }
+      recipients.append(m_selectedKeyIndexEdit->text());
+    }
+    res = m_backend->signAndEncrypt(v->document()->text(), recipients,
+                                    symmetric);
+  } else if (!symmetric && !recipientSet.isEmpty()) {
+    res = m_backend->encryptStringToRecipients(
+        v->document()->text(),
+        m_gpgWrapper->recipientCache().recipientSetFingerprints(recipientSet));
+  } else if (!symmetric && fingerprints.size() > 1) {
+    res = m_backend->encryptStringToRecipients(v->document()->text(),
+                                               fingerprints);
+  } else {
+    if (m_selectedKeyIndexEdit->text().isEmpty()) {
+      pluginMessageBox("Error Encrypting Text!", "No fingerprint selected...");
+      return;
+    }
+    res = m_backend->encryptString(
+        v->document()->text(), m_selectedKeyIndexEdit->text(),
+        m_preferredEmailAddressComboBox->itemText(
+            m_preferredEmailAddressComboBox->currentIndex()),
+        symmetric);
   }
-
-  GPGOperationResult res = m_gpgWrapper->encryptString(
-      v->document()->text(), m_selectedKeyIndexEdit->text(),
-      m_preferredEmailAddressComboBox->itemText(
-          m_preferredEmailAddressComboBox->currentIndex()),
-      m_symmetricEncryptioCheckbox->isChecked());
   if (!res.keyFound) {
     pluginMessageBox("Error Decrypting Text!",
                      "No Matching Fingerprint found...\n" + res.errorMessage);
@@ -297,8 +799,7 @@ void KateGPGPluginView::encryptButtonPressed() {
     pluginMessageBox("Error Encrypting Text!", res.errorMessage);
     return;
   }
-  v->document()->text();
-  v->document()->setText(res.resultString);
+  GPGDocumentUpdater::replaceText(v->document(), res.resultString);
 }
 
 void KateGPGPluginView::onTableViewSelection() {
@@ -307,46 +808,290 @@ void KateGPGPluginView::onTableViewSelection() {
    * search for the selected table row by key fingerprint in the
    * list of available GPG keys.
    */
+  // This only reads the loaded keys, nothing is listed here.
+  noteToolviewActivity();
+  GPGUpdateTimer timer(m_timings.selectionMs);
+  GPGEngineStats::ActionScope scope("key selection", 0);
   m_preferredEmailAddressComboBox->clear();
-  m_gpgWrapper->loadKeys(m_showOnlyPrivateKeysCheckbox->isChecked(), m_hideExpiredKeysCheckbox->isChecked(), m_preferredEmailLineEdit->text());
   QModelIndexList selectedList =
       m_gpgKeyTable->selectionModel()->selectedRows();
-  // Currently it is possible to select multiple rows in the QTableWidget.
-  // For now we will only consider the first selected row.
+  // Multiple selected rows are all used as recipients for encryption,
+  // the first one is used for the mail address and fingerprint fields.
   if (selectedList.size() > 0) {
     m_selectedRowIndex = selectedList.at(0).row();
     const QString selectedFingerPrint(
         m_gpgKeyTable->item(m_selectedRowIndex, 0)->text());
-    const QVector<GPGKeyDetails> keys = m_gpgWrapper->getKeys();
+    const QVector<GPGKeyDetails> &keys = m_gpgWrapper->getKeys();
     if (m_selectedRowIndex <= keys.size()) {
-      for (auto key = m_gpgWrapper->getKeys().begin();
-           key != m_gpgWrapper->getKeys().end(); ++key) {
-        GPGKeyDetails d = *key;
-        if (selectedFingerPrint == d.fingerPrint()) {
-          const QVector<QString> mailAddresses = d.mailAdresses();
-          for (auto &r : mailAddresses) {
-            m_preferredEmailAddressComboBox->addItem(r);
+      // the primary key ID ends the fingerprint, only two keys sharing it
+      // need the scan (compared as views, nothing is copied)
+      int index =
+          m_gpgWrapper->findKeyIndexByKeyID(selectedFingerPrint.right(16));
+      if (index < 0 ||
+          keys.at(index).fingerPrintView() != selectedFingerPrint) {
+        index = -1;
+        for (auto i = 0; i < keys.size() && index < 0; ++i) {
+          if (keys.at(i).fingerPrintView() == selectedFingerPrint) {
+            index = i;
           }
-          m_selectedKeyIndexEdit->setText(d.fingerPrint());
-          return;
         }
       }
+      if (index >= 0) {
+        const GPGKeyDetails &d = keys.at(index);
+        for (auto &r : d.mailAdresses()) {
+          m_preferredEmailAddressComboBox->addItem(r.toString());
+        }
+        m_selectedKeyIndexEdit->setText(d.fingerPrint());
+      }
+    }
+  }
+}
+
+QString KateGPGPluginView::currentDocumentFolder() const {
+  KTextEditor::View *v = m_mainWindow->activeView();
+  if (v && v->document() && v->document()->url().isLocalFile()) {
+    return QFileInfo(v->document()->url().toLocalFile()).absolutePath();
+  }
+  return QDir::homePath();
+}
+
+void KateGPGPluginView::onVerifyFolderPressed() {
+  GPGEngineStats::ActionScope scope("verify folder");
+  if (m_signatureVerifier->isRunning()) {
+    pluginMessageBox("Verification running", "Please wait until the current "
+                                             "verification has finished.");
+    return;
+  }
+  const QString folder = QFileDialog::getExistingDirectory(
+      m_toolview.get(), "Verify signatures in folder", currentDocumentFolder());
+  if (folder.isEmpty()) {
+    return;
+  }
+  m_resultsBrowser->clear();
+  m_resultsBrowser->show();
+  m_resultsBrowser->append(
+      ("Verifying signatures in " + folder + " ...").toHtmlEscaped());
+  m_verifyFolderButton->setEnabled(false);
+  m_signatureVerifier->verifyFolder(folder, m_gpgWrapper->keyringGeneration());
+}
+
+void KateGPGPluginView::onFileVerified(const QString &signedFile_, bool valid_,
+                                       const QString &summary_,
+                                       bool fromCache_) {
+  // plain text, file names and signer user IDs must not be interpreted
+  // as HTML
+  m_resultsBrowser->append(((valid_ ? "OK    " : "FAIL  ") + signedFile_ +
+                            ": " + summary_ + (fromCache_ ? " (cached)" : ""))
+                               .toHtmlEscaped());
+}
+
+void KateGPGPluginView::onFolderVerificationFinished(int numFiles_,
+                                                     int numValid_,
+                                                     int numFromCache_) {
+  m_verifyFolderButton->setEnabled(true);
+  m_resultsBrowser->append(
+      QString("Done: %1 of %2 signatures valid (%3 unchanged, from cache).")
+          .arg(numValid_)
+          .arg(numFiles_)
+          .arg(numFromCache_));
+}
+
+void KateGPGPluginView::onSearchEncryptedPressed() {
+  GPGEngineStats::ActionScope scope("search encrypted files");
+  if (m_encryptedSearch->isRunning()) {
+    pluginMessageBox("Search running",
+                     "Please wait until the current search has finished.");
+    return;
+  }
+  const QString pattern = m_searchPatternLineEdit->text();
+  if (pattern.isEmpty()) {
+    pluginMessageBox("Nothing to search", "Please enter a search text.");
+    return;
+  }
+  const QString folder = QFileDialog::getExistingDirectory(
+      m_toolview.get(), "Search encrypted files in folder",
+      currentDocumentFolder());
+  if (folder.isEmpty()) {
+    return;
+  }
+  m_resultsBrowser->clear();
+  m_resultsBrowser->show();
+  // one passphrase prompt for the whole search, see onSearchFinished()
+  m_searchPassphraseProvider = activePassphraseProvider();
+  if (m_searchPassphraseProvider) {
+    m_searchPassphraseProvider->beginBatch();
+  }
+  const int numFiles = m_encryptedSearch->search(
+      folder, pattern, m_searchRegExpCheckbox->isChecked(), false,
+      &m_gpgWrapper->plaintextCache(), m_searchPassphraseProvider);
+  if (numFiles < 0) {
+    if (m_searchPassphraseProvider) {
+      m_searchPassphraseProvider->endBatch();
+      m_searchPassphraseProvider = nullptr;
+    }
+    m_resultsBrowser->append(
+        ("Invalid regular expression: " + pattern).toHtmlEscaped());
+    return;
+  }
+  m_resultsBrowser->append(
+      QString("Searching %1 files in %2 ...")
+          .arg(numFiles)
+          .arg(folder)
+          .toHtmlEscaped());
+  m_searchEncryptedButton->setEnabled(numFiles == 0);
+}
+
+void KateGPGPluginView::onSearchMatchFound(const QString &file_, int line_,
+                                           const QString &lineText_) {
+  // plain text, the decrypted line must not be interpreted as HTML
+  m_resultsBrowser->append((file_ + ":" + QString::number(line_) + ": " +
+                            lineText_.trimmed())
+                               .toHtmlEscaped());
+}
+
+void KateGPGPluginView::onSearchFileFailed(const QString &file_,
+                                           const QString &errorMessage_) {
+  m_resultsBrowser->append(
+      ("FAIL  " + file_ + ": " + errorMessage_).toHtmlEscaped());
+}
+
+void KateGPGPluginView::onSearchFinished(int numFiles_, int numMatches_,
+                                         int numFailed_) {
+  m_searchEncryptedButton->setEnabled(true);
+  if (m_searchPassphraseProvider) {
+    // wipes the passphrase
+    m_searchPassphraseProvider->endBatch();
+    m_searchPassphraseProvider = nullptr;
+  }
+  m_resultsBrowser->append(
+      QString("Done: %1 matching lines in %2 files (%3 could not be "
+              "decrypted).")
+          .arg(numMatches_)
+          .arg(numFiles_)
+          .arg(numFailed_));
+}
+
+QStringList KateGPGPluginView::selectedFingerprints() const {
+  QStringList fingerprints;
+  const QModelIndexList selectedList =
+      m_gpgKeyTable->selectionModel()->selectedRows();
+  for (auto &index : selectedList) {
+    const QTableWidgetItem *item = m_gpgKeyTable->item(index.row(), 0);
+    if (item) {
+      fingerprints.append(item->text());
+    }
+  }
+  return fingerprints;
+}
+
+void KateGPGPluginView::onSaveRecipientSetPressed() {
+  const QStringList fingerprints = selectedFingerprints();
+  if (fingerprints.isEmpty()) {
+    pluginMessageBox("Error Saving Recipient Set!", "No keys selected...");
+    return;
+  }
+  bool ok = false;
+  const QString name = QInputDialog::getText(
+      m_toolview.get(), "Save Recipient Set",
+      QString("Name for a set of %1 recipient keys:").arg(fingerprints.size()),
+      QLineEdit::Normal, m_recipientSetComboBox->currentIndex() > 0
+                             ? m_recipientSetComboBox->currentText()
+                             : QString(),
+      &ok);
+  if (!ok || name.trimmed().isEmpty()) {
+    return;
+  }
+  m_gpgWrapper->recipientCache().setRecipientSet(name.trimmed(), fingerprints);
+  updateRecipientSetComboBox(name.trimmed());
+}
+
+void KateGPGPluginView::onDeleteRecipientSetPressed() {
+  if (m_recipientSetComboBox->currentIndex() <= 0) {
+    return;
+  }
+  m_gpgWrapper->recipientCache().removeRecipientSet(
+      m_recipientSetComboBox->currentText());
+  updateRecipientSetComboBox(QString());
+}
+
+void KateGPGPluginView::onSuggestRecipientsPressed() {
+  noteToolviewActivity();
+  GPGEngineStats::ActionScope scope("suggest recipients", 0);
+  KTextEditor::View *v = m_mainWindow->activeView();
+  if (!v || !v->document() || v->document()->isEmpty()) {
+    pluginMessageBox("No recipients found", "Document is empty..");
+    return;
+  }
+  const QStringList fingerprints =
+      m_gpgWrapper->suggestRecipients(v->document()->text());
+  if (fingerprints.isEmpty()) {
+    pluginMessageBox("No recipients found",
+                     "The document does not mention the mail address of "
+                     "any of your keys.");
+    return;
+  }
+  const int numShown = selectKeysByFingerprints(fingerprints);
+  // encrypt to the selected keys, not to a saved set
+  m_recipientSetComboBox->setCurrentIndex(0);
+  if (numShown < fingerprints.size()) {
+    pluginMessageBox(
+        "Recipients found",
+        QString("%1 of %2 matching keys are hidden by the key filters.")
+            .arg(fingerprints.size() - numShown)
+            .arg(fingerprints.size()));
+  }
+}
+
+void KateGPGPluginView::updateRecipientSetComboBox(const QString &selectedName_) {
+  m_recipientSetComboBox->clear();
+  m_recipientSetComboBox->addItem("(Selected keys)");
+  m_recipientSetComboBox->addItems(
+      m_gpgWrapper->recipientCache().recipientSetNames());
+  const int index = m_recipientSetComboBox->findText(selectedName_);
+  m_recipientSetComboBox->setCurrentIndex(index > 0 ? index : 0);
+}
+
+void KateGPGPluginView::selectKeyByFingerprint(const QString &fingerprint_) {
+  if (m_selectedKeyIndexEdit->text() == fingerprint_) {
+    return;
+  }
+  for (auto row = 0; row < m_gpgKeyTable->rowCount(); ++row) {
+    const QTableWidgetItem *item = m_gpgKeyTable->item(row, 0);
+    if (item && item->text() == fingerprint_) {
+      m_gpgKeyTable->selectRow(row);
+      m_gpgKeyTable->scrollToItem(item);
+      return;
     }
   }
 }
 
-QString
-concatenateEmailAddressesToString(const QVector<QString> uids_,
-                                  const QVector<QString> mailAddresses_,
-                                  const QVector<QString> subkeyIDs_) {
-  assert(uids_.size() == mailAddresses_.size());
-  QString out = "";
-  for (auto i = 0; i < mailAddresses_.size(); ++i) {
-    out += uids_.at(i) + " <";
-    out += mailAddresses_.at(i) + "> ";
-    out += "(" + subkeyIDs_.at(i) + ")\n";
+int KateGPGPluginView::selectKeysByFingerprints(
+    const QStringList &fingerprints_) {
+  const QSet<QString> wanted(fingerprints_.begin(), fingerprints_.end());
+  QItemSelection selection;
+  for (auto row = 0; row < m_gpgKeyTable->rowCount(); ++row) {
+    const QTableWidgetItem *item = m_gpgKeyTable->item(row, 0);
+    if (item && wanted.contains(item->text())) {
+      selection.select(m_gpgKeyTable->model()->index(row, 0),
+                       m_gpgKeyTable->model()->index(row, 0));
+    }
   }
-  return out;
+  if (!selection.isEmpty()) {
+    // one selection change for all rows
+    m_gpgKeyTable->selectionModel()->select(
+        selection, QItemSelectionModel::ClearAndSelect |
+                       QItemSelectionModel::Rows);
+    m_gpgKeyTable->scrollTo(selection.first().topLeft());
+  }
+  return selection.size();
+}
+
+// the user ID cell keeps the lines for GPGUidDelegate, the text is only
+// used to notice changes
+void setUidCellLines(QTableWidgetItem *item_, const QStringList &lines_) {
+  item_->setText(lines_.join('\n'));
+  item_->setData(GPGUidDelegate::uidLinesRole, lines_);
+  item_->setToolTip(lines_.join('\n'));
 }
 
 void KateGPGPluginView::makeTableCell(const QString cellValue, uint row,
@@ -355,44 +1100,296 @@ void KateGPGPluginView::makeTableCell(const QString cellValue, uint row,
   m_gpgKeyTable->setItem(row, col, item);
 }
 
+// the cell texts of a key table row, the last one are the user ID lines
+QStringList keyTableRow(const GPGKeyDetails &d_) {
+  return QStringList()
+         << d_.fingerPrint() << d_.creationDate() << d_.expiryDate()
+         << d_.keyLength()
+         << GPGUidDelegate::uidLines(d_).join('\n');
+}
+
+const QString hexDigits = "0123456789ABCDEF";
+
+// the widest of hexDigits in the font of fm_
+QChar widestHexDigit(const QFontMetrics &fm_) {
+  QChar widest = '0';
+  for (auto &c : hexDigits) {
+    if (fm_.horizontalAdvance(c) > fm_.horizontalAdvance(widest)) {
+      widest = c;
+    }
+  }
+  return widest;
+}
+
+// the width of text_ if every hex digit in it was widest_, so fingerprints
+// and dates need not be measured one by one
+int fixedFormatWidth(const QFontMetrics &fm_, QChar widest_,
+                     const QString &text_) {
+  QString pattern = text_;
+  for (auto &c : pattern) {
+    if (hexDigits.contains(c)) {
+      c = widest_;
+    }
+  }
+  return fm_.horizontalAdvance(pattern);
+}
+
+// the length of the longest line GPGUidDelegate draws for the user ID cell
+// text uidCell_, without splitting it
+int longestVisibleUidLine(const QString &uidCell_) {
+  const int numLines = uidCell_.count('\n') + 1;
+  // with more lines, the last visible one is a short summary instead
+  const int numMeasured = numLines > GPGUidDelegate::maxVisibleLines
+                              ? GPGUidDelegate::maxVisibleLines - 1
+                              : numLines;
+  int longest = 0;
+  int start = 0;
+  for (auto i = 0; i < numMeasured; ++i) {
+    int end = uidCell_.indexOf('\n', start);
+    if (end < 0) {
+      end = uidCell_.size();
+    }
+    longest = qMax(longest, end - start);
+    start = end + 1;
+  }
+  return longest;
+}
+
+void KateGPGPluginView::updateColumnWidths(
+    const QVector<QStringList> &changedRows_) {
+  // more rows hardly ever change a column width, but cost a measurement
+  const int maxSampleRows = 64;
+  const int numColumns = m_gpgKeyTable->columnCount();
+  if (m_columnWidths.size() != numColumns) {
+    // the header labels are the minimum width
+    m_columnWidths.fill(0, numColumns);
+    const QFontMetrics headerFm =
+        m_gpgKeyTable->horizontalHeader()->fontMetrics();
+    QStyle *style = m_gpgKeyTable->style();
+    const int headerPadding = 2 * style->pixelMetric(QStyle::PM_HeaderMargin) +
+                              style->pixelMetric(QStyle::PM_HeaderMarkSize);
+    for (auto col = 0; col < qMin(numColumns, m_gpgKeyTableHeader.size());
+         ++col) {
+      m_columnWidths[col] =
+          headerFm.horizontalAdvance(m_gpgKeyTableHeader.at(col)) +
+          headerPadding;
+    }
+  }
+  const QFontMetrics fm = m_gpgKeyTable->fontMetrics();
+  // the space QStyledItemDelegate keeps left and right of the text
+  const int cellPadding =
+      2 * (m_gpgKeyTable->style()->pixelMetric(QStyle::PM_FocusFrameHMargin) +
+           1);
+  if (m_widestHexDigit.isNull() ||
+      m_widestHexDigitFont != m_gpgKeyTable->font()) {
+    m_widestHexDigitFont = m_gpgKeyTable->font();
+    m_widestHexDigit = widestHexDigit(fm);
+  }
+  // A sample of the rows, plus the row with the longest text of each
+  // column: comparing lengths is cheap, measuring is not, and the longest
+  // text is the most likely to need a wider column.
+  QVector<int> measuredRows;
+  const int step = qMax(1, changedRows_.size() / maxSampleRows);
+  for (auto i = 0; i < changedRows_.size(); i += step) {
+    measuredRows.append(i);
+  }
+  QVector<int> longestRow(numColumns, -1);
+  QVector<int> longestLength(numColumns, -1);
+  for (auto i = 0; i < changedRows_.size(); ++i) {
+    const QStringList &cells = changedRows_.at(i);
+    for (auto col = 0; col < qMin(numColumns, cells.size()); ++col) {
+      const int length = col == 4 ? longestVisibleUidLine(cells.at(col))
+                                  : cells.at(col).size();
+      if (length > longestLength.at(col)) {
+        longestLength[col] = length;
+        longestRow[col] = i;
+      }
+    }
+  }
+  for (auto row : longestRow) {
+    if (row >= 0 && !measuredRows.contains(row)) {
+      measuredRows.append(row);
+    }
+  }
+  QVector<int> widths = m_columnWidths;
+  for (auto i : measuredRows) {
+    const QStringList &cells = changedRows_.at(i);
+    for (auto col = 0; col < qMin(numColumns, cells.size()); ++col) {
+      int width;
+      if (col == 4) {
+        width = GPGUidDelegate::linesWidth(fm, cells.at(col).split('\n'));
+      } else if (col == 3) {
+        width = fm.horizontalAdvance(cells.at(col)) + cellPadding;
+      } else {
+        // fingerprint and dates
+        width = fixedFormatWidth(fm, m_widestHexDigit, cells.at(col)) +
+                cellPadding;
+      }
+      widths[col] = qMax(widths[col], width);
+    }
+  }
+  // Columns only grow, so a refresh never measures all rows and filtering
+  // does not make the columns jump.
+  for (auto col = 0; col < numColumns; ++col) {
+    if (widths.at(col) != m_gpgKeyTable->columnWidth(col)) {
+      m_gpgKeyTable->setColumnWidth(col, widths.at(col));
+    }
+  }
+  m_columnWidths = widths;
+}
+
 void KateGPGPluginView::updateKeyTable() {
+  if (m_gpgKeyTableHeader.isEmpty()) {
+    m_gpgKeyTableHeader << "Key Fingerprint"
+                        << "Creation Date"
+                        << "Expiry Date"
+                        << "Key Length"
+                        << "User IDs";
+    m_gpgKeyTable->setHorizontalHeaderLabels(m_gpgKeyTableHeader);
+    // several selected keys are all used as recipients
+    m_gpgKeyTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_gpgKeyTable->sortByColumn(1, Qt::DescendingOrder);
+    m_gpgKeyTable->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_gpgKeyTable->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_gpgKeyTable->setMinimumHeight(250);
+    m_gpgKeyTable->setMaximumHeight(500);
+    m_gpgKeyTable->setSizePolicy(QSizePolicy::Expanding,
+                                 QSizePolicy::Expanding);
+  }
+
+  // Remember the key at the top of the view, rows above it may come and go.
+  QString topFingerprint;
+  int topOffset = 0;
+  const int topRow = m_gpgKeyTable->rowAt(0);
+  if (topRow >= 0 && m_gpgKeyTable->item(topRow, 0)) {
+    topFingerprint = m_gpgKeyTable->item(topRow, 0)->text();
+    topOffset = m_gpgKeyTable->rowViewportPosition(topRow);
+  }
+
+  // Rows are matched to keys by fingerprint. Only rows of added, removed
+  // or changed keys are touched, so the selection stays where it is.
+  // Unchanged keys are compared as views, without copying any string.
+  QVector<QString> rowFingerprints(m_gpgKeyTable->rowCount());
+  QHash<QStringView, int> rowByFingerprint;
+  rowByFingerprint.reserve(m_gpgKeyTable->rowCount());
+  for (auto row = 0; row < m_gpgKeyTable->rowCount(); ++row) {
+    const QTableWidgetItem *item = m_gpgKeyTable->item(row, 0);
+    if (item) {
+      rowFingerprints[row] = item->text();
+      rowByFingerprint.insert(rowFingerprints.at(row), row);
+    }
+  }
+  const QString selectedFingerprint = m_selectedKeyIndexEdit->text();
+  bool rowsChanged = false;
+  bool selectedKeyChanged = false;
+  QVector<QStringList> changedRows; // for the column widths
+  // Row heights only depend on the number of user IDs, no text layout (as
+  // in resizeRowsToContents()) is needed. Most keys have one user ID, so
+  // that is the default height and only the rows of added or changed keys
+  // are given their own. QHeaderView keeps those with the rows when the
+  // table is sorted.
+  const QFontMetrics fm = m_gpgKeyTable->fontMetrics();
+  QHeaderView *rowHeader = m_gpgKeyTable->verticalHeader();
+  const int singleLineHeight = m_uidDelegate->rowHeight(fm, 1);
+  if (rowHeader->defaultSectionSize() != singleLineHeight) {
+    rowHeader->setDefaultSectionSize(singleLineHeight);
+  }
+  const auto setRowHeight = [this, &fm](int row_, int numLines_) {
+    const int height = m_uidDelegate->rowHeight(fm, numLines_);
+    if (m_gpgKeyTable->rowHeight(row_) != height) {
+      m_gpgKeyTable->setRowHeight(row_, height);
+    }
+  };
   m_gpgKeyTable->setSortingEnabled(false);
-  m_gpgKeyTable->setRowCount(0);
-  m_gpgKeyTableHeader << "Key Fingerprint"
-                      << "Creation Date"
-                      << "Expiry Date"
-                      << "Key Length"
-                      << "User IDs";
-  m_gpgKeyTable->setHorizontalHeaderLabels(m_gpgKeyTableHeader);
-  m_gpgKeyTable->resizeColumnsToContents();
   const QVector<GPGKeyDetails> &keyDetailsList = m_gpgWrapper->getKeys();
-  uint numRows = 0;
-  for (auto row = 0; row < m_gpgWrapper->getNumKeys(); ++row) {
-    GPGKeyDetails d = keyDetailsList.at(row);
-    m_gpgKeyTable->insertRow(m_gpgKeyTable->rowCount());
-    makeTableCell(d.fingerPrint(), numRows, 0);
-    makeTableCell(d.creationDate(), numRows, 1);
-    makeTableCell(d.expiryDate(), numRows, 2);
-    makeTableCell(d.keyLength(), numRows, 3);
-    QString uidsAndMails(
-        concatenateEmailAddressesToString(d.uids(), d.mailAdresses(), d.subkeyIDs()));
-    makeTableCell(uidsAndMails, numRows, 4);
-    ++numRows;
-  }
-  m_gpgKeyTable->resizeRowsToContents();
-  m_gpgKeyTable->setSelectionMode(QAbstractItemView::ContiguousSelection);
-  m_gpgKeyTable->sortByColumn(1, Qt::DescendingOrder);
-  m_gpgKeyTable->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
-  m_gpgKeyTable->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
+  for (auto &d : keyDetailsList) {
+    const auto existing = rowByFingerprint.find(d.fingerPrintView());
+    if (existing == rowByFingerprint.end()) {
+      const QStringList cells = keyTableRow(d);
+      const int newRow = m_gpgKeyTable->rowCount();
+      m_gpgKeyTable->insertRow(newRow);
+      for (auto col = 0; col < cells.size(); ++col) {
+        makeTableCell(cells.at(col), newRow, col);
+      }
+      const QStringList lines = cells.at(4).split('\n');
+      setUidCellLines(m_gpgKeyTable->item(newRow, 4), lines);
+      setRowHeight(newRow, lines.size());
+      rowsChanged = true;
+      changedRows.append(cells);
+      continue;
+    }
+    const int row = existing.value();
+    rowByFingerprint.erase(existing);
+    const QStringView keyCells[] = {d.creationDateView(), d.expiryDateView(),
+                                    d.keyLengthView()};
+    bool rowChanged = false;
+    for (auto col = 1; col < 4 && !rowChanged; ++col) {
+      const QTableWidgetItem *item = m_gpgKeyTable->item(row, col);
+      rowChanged = item && QStringView(item->text()) != keyCells[col - 1];
+    }
+    const QTableWidgetItem *uidItem = m_gpgKeyTable->item(row, 4);
+    rowChanged = rowChanged ||
+                 (uidItem &&
+                  !GPGUidDelegate::uidLinesEqual(
+                      uidItem->data(GPGUidDelegate::uidLinesRole)
+                          .toStringList(),
+                      d));
+    if (!rowChanged) {
+      continue;
+    }
+    const QStringList cells = keyTableRow(d);
+    for (auto col = 1; col < cells.size(); ++col) {
+      QTableWidgetItem *item = m_gpgKeyTable->item(row, col);
+      if (item && item->text() != cells.at(col)) {
+        if (col == 4) {
+          const QStringList lines = cells.at(col).split('\n');
+          setUidCellLines(item, lines);
+          setRowHeight(row, lines.size());
+        } else {
+          item->setText(cells.at(col));
+        }
+      }
+    }
+    rowsChanged = true;
+    selectedKeyChanged =
+        selectedKeyChanged || d.fingerPrintView() == selectedFingerprint;
+    changedRows.append(cells);
+  }
+  // whatever is left is gone from the keys list, remove bottom up so the
+  // remaining row numbers stay valid
+  QList<int> removedRows = rowByFingerprint.values();
+  std::sort(removedRows.begin(), removedRows.end(), std::greater<int>());
+  for (auto row : removedRows) {
+    m_gpgKeyTable->removeRow(row);
+    rowsChanged = true;
+  }
   m_gpgKeyTable->setSortingEnabled(true);
-  if (m_gpgKeyTable->rowCount() > 0) {
-    m_gpgKeyTable->selectRow(0);
-  }
-  m_gpgKeyTable->setMinimumHeight(250);
-  m_gpgKeyTable->setMaximumHeight(500);
-  m_gpgKeyTable->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
-  m_gpgKeyTable->resizeColumnsToContents();
-  m_gpgKeyTable->resizeRowsToContents();
+
+  if (rowsChanged) {
+    updateColumnWidths(changedRows);
+  }
+  if (!topFingerprint.isEmpty()) {
+    const QList<QTableWidgetItem *> topItems =
+        m_gpgKeyTable->findItems(topFingerprint, Qt::MatchExactly);
+    for (auto item : topItems) {
+      if (item->column() == 0) {
+        QScrollBar *scrollBar = m_gpgKeyTable->verticalScrollBar();
+        scrollBar->setValue(scrollBar->value() +
+                            m_gpgKeyTable->rowViewportPosition(item->row()) -
+                            topOffset);
+        break;
+      }
+    }
+  }
+  if (m_gpgKeyTable->selectionModel()->selectedRows().isEmpty()) {
+    // nothing (left) selected, take the most recent key
+    if (m_gpgKeyTable->rowCount() > 0) {
+      m_gpgKeyTable->selectRow(0);
+    }
+  } else if (selectedKeyChanged) {
+    // same key, but e.g. a new user ID
+    onTableViewSelection();
+  }
 }
 
 #include "kate_gpg_plugin.moc"
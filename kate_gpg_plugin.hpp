@@ -29,13 +29,42 @@
 #include <QPushButton>
 #include <QTableWidget>
 #include <QTextBrowser>
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QSettings>
 #include <memory>
 #include <GPGMeWrapper.hpp>
+#include <GPGEncryptedSearch.hpp>
+#include <GPGKeyLoader.hpp>
+#include <GPGSignatureVerifier.hpp>
 
-// forward declaration
+// forward declarations
 class GPGKeyDetails;
+class GPGUidDelegate;
+
+/**
+ * Everything in the toolview that changes what is shown or cached.
+ * The UI signals only mark the view state as dirty, all changes of one
+ * event loop turn are then applied in one go (see applyViewState()).
+ */
+struct GPGViewState {
+  GPGKeyFilter keyFilter;
+  bool usePlaintextCache = false;
+  GPGCompressionMode compressionMode = GPGCompressionMode::Automatic;
+
+  bool operator==(const GPGViewState &other_) const;
+  bool operator!=(const GPGViewState &other_) const;
+};
+
+/**
+ * Wall clock times of the last toolview updates in milliseconds (-1 = not
+ * yet run). tests/KateGPGPluginViewTest.cpp checks them against budgets.
+ */
+struct GPGViewTimings {
+  qint64 keysShownMs = -1;   // a new key listing put into the table
+  qint64 viewStateMs = -1;   // filters and checkboxes applied
+  qint64 selectionMs = -1;   // a changed key selection
+};
 
 class KateGPGPlugin : public KTextEditor::Plugin {
   Q_OBJECT
@@ -51,12 +80,17 @@ class KateGPGPluginView : public QObject, public KXMLGUIClient {
   Q_OBJECT
 
 public:
-  explicit KateGPGPluginView(KateGPGPlugin *plugin, KTextEditor::MainWindow *mainwindow);
+  // backend_ lists the keys and encrypts instead of gpg (nullptr = gpg)
+  explicit KateGPGPluginView(KateGPGPlugin *plugin, KTextEditor::MainWindow *mainwindow,
+                             GPGBackend *backend_ = nullptr);
 
   ~KateGPGPluginView();
 
   void onViewChanged(KTextEditor::View *v);
 
+  // notices the mouse entering or the toolview being shown
+  bool eventFilter(QObject *watched_, QEvent *event_) override;
+
 public slots:
   void setPreferredEmailAddress();  // use your own email address if you want to
                                     // encrypt to yourself
@@ -66,6 +100,38 @@ public slots:
   void onHideExpiredKeysChanged();
   void decryptButtonPressed();
   void encryptButtonPressed();
+  void onPlaintextCacheChanged();
+  void onCompressionModeChanged();
+  void onSaveRecipientSetPressed();
+  void onDeleteRecipientSetPressed();
+  void onSuggestRecipientsPressed();
+  void onVerifyFolderPressed();
+  void onFileVerified(const QString &signedFile_, bool valid_,
+                      const QString &summary_, bool fromCache_);
+  void onFolderVerificationFinished(int numFiles_, int numValid_,
+                                    int numFromCache_);
+  void onSearchEncryptedPressed();
+  void onSearchMatchFound(const QString &file_, int line_,
+                          const QString &lineText_);
+  void onSearchFileFailed(const QString &file_, const QString &errorMessage_);
+  void onSearchFinished(int numFiles_, int numMatches_, int numFailed_);
+  void onKeysListed(quint64 requestID_);
+
+private slots:
+  // applies all view state changes since the last call at once
+  void applyViewState();
+
+  // frees the keys and caches after m_idleTrimMinutes without activity
+  void onToolviewIdle();
+
+  // drops cached plaintexts that outlived their time to live
+  void onPlaintextCacheExpiry();
+
+public:
+  // how often the view state was applied, for checking the coalescing
+  quint64 numViewStateUpdates() const;
+  GPGBackend *backend() const;
+  const GPGViewTimings &timings() const;
 
 private:
   KTextEditor::MainWindow *m_mainWindow = nullptr;
@@ -75,11 +141,52 @@ private:
   const QString m_settingsName = QString("kate_gpg_plugin_settings");
 
   GPGMeWrapper *m_gpgWrapper = nullptr;
+  // where the key listings come from, m_gpgWrapper unless set otherwise
+  GPGBackend *m_backend = nullptr;
+
+  GPGViewTimings m_timings;
 
   int m_selectedRowIndex;
 
   QPushButton *m_gpgDecryptButton = nullptr;
   QPushButton *m_gpgEncryptButton = nullptr;
+  QPushButton *m_verifyFolderButton = nullptr;
+  QLineEdit *m_searchPatternLineEdit = nullptr;
+  QCheckBox *m_searchRegExpCheckbox = nullptr;
+  QPushButton *m_searchEncryptedButton = nullptr;
+
+  // output of folder wide operations (signature verification, search)
+  QTextBrowser *m_resultsBrowser = nullptr;
+
+  // asks for passphrases if m_loopbackPinentryCheckbox is checked,
+  // declared before the workers that use it so it outlives them
+  std::unique_ptr<GPGPassphraseProvider> m_passphraseProvider;
+  // the provider of the running folder search (its batch)
+  GPGPassphraseProvider *m_searchPassphraseProvider = nullptr;
+
+  std::unique_ptr<GPGSignatureVerifier> m_signatureVerifier;
+  std::unique_ptr<GPGEncryptedSearch> m_encryptedSearch;
+
+  // lists the keys in the background, see reloadKeys()
+  std::unique_ptr<GPGKeyLoader> m_keyLoader;
+
+  // the view state that was applied last (see applyViewState())
+  GPGViewState m_viewState;
+  bool m_viewStateApplied = false;
+  bool m_viewStateUpdateScheduled = false;
+  quint64 m_numViewStateUpdates = 0;
+
+  // restored from the settings once the first keys are shown
+  int m_pendingMailAddressIndex = -1;
+
+  // runs onPlaintextCacheExpiry() while the plaintext cache is enabled
+  QTimer *m_plaintextExpiryTimer = nullptr;
+
+  // see onToolviewIdle(), 0 minutes = never
+  QTimer *m_idleTimer = nullptr;
+  int m_idleTrimMinutes = 30;
+  bool m_keysTrimmed = false;
+  QStringList m_trimmedSelection; // selected again once the keys are back
 
   QVBoxLayout *m_verticalLayout;
   QLabel *m_titleLabel;
@@ -92,23 +199,87 @@ private:
   QLabel *m_EmailAddressSelectLabel;
   QComboBox *m_preferredEmailAddressComboBox;
   QLineEdit *m_selectedKeyIndexEdit;
+  QLabel *m_recipientSetLabel;
+  QComboBox *m_recipientSetComboBox;
+  QPushButton *m_saveRecipientSetButton;
+  QPushButton *m_deleteRecipientSetButton;
+  QPushButton *m_suggestRecipientsButton;
   QCheckBox *m_saveAsASCIICheckbox;
   QCheckBox *m_symmetricEncryptioCheckbox;
   QCheckBox *m_showOnlyPrivateKeysCheckbox;
   QCheckBox *m_hideExpiredKeysCheckbox;
+  QCheckBox *m_signAndVerifyCheckbox;
+  QCheckBox *m_loopbackPinentryCheckbox;
+  QCheckBox *m_plaintextCacheCheckbox;
+  QComboBox *m_compressionComboBox;
   QTableWidget *m_gpgKeyTable;
+  // draws the user ID column, owned by m_gpgKeyTable
+  GPGUidDelegate *m_uidDelegate = nullptr;
   QStringList m_gpgKeyTableHeader;
+  // the column widths set by updateColumnWidths(), kept across refreshes
+  QVector<int> m_columnWidths;
+  // measured once per font of m_gpgKeyTable, see updateColumnWidths()
+  QFont m_widestHexDigitFont;
+  QChar m_widestHexDigit;
 
   QSettings* m_pluginSettings;
 
   // private functions
   void updateKeyTable();
 
+  /**
+   * Widens the table columns for added or changed rows. Fingerprints and
+   * dates are sized from the font metrics, the other columns from at most
+   * a few dozen of the given rows plus the row with the longest text of
+   * each column.
+   */
+  void updateColumnWidths(const QVector<QStringList> &changedRows_);
+
+  // the filters currently set in the UI
+  GPGKeyFilter currentKeyFilter() const;
+
+  // reads the view state from the widgets
+  GPGViewState currentViewState() const;
+
+  // queues one applyViewState() for the next event loop turn
+  void scheduleViewStateUpdate();
+
+  // restarts the idle timer and brings back trimmed keys
+  void noteToolviewActivity();
+
+  // m_passphraseProvider if it is switched on, otherwise nullptr (pinentry)
+  GPGPassphraseProvider *activePassphraseProvider() const;
+
+  /**
+   * Shows the cached keys right away (if there are any) and lists all
+   * keys in the background unless the cache is still valid. Changing the
+   * filters does not need this, see applyViewState().
+   */
+  void reloadKeys();
+
+  // updates the key table and keeps (or restores) the selected key
+  void showKeys();
+
   const QTableWidgetItem
   convertKeyDetailsToTableItem(const GPGKeyDetails &keyDetails_);
 
   void makeTableCell(const QString cellValue, uint row, uint col);
 
+  // the folder of the current document, or the home folder
+  QString currentDocumentFolder() const;
+
+  // the fingerprints of all selected table rows
+  QStringList selectedFingerprints() const;
+
+  // refills the recipient set combo box and selects the given set
+  void updateRecipientSetComboBox(const QString &selectedName_);
+
+  // selects (and scrolls to) the table row showing the given key
+  void selectKeyByFingerprint(const QString &fingerprint_);
+
+  // selects the rows of all given keys, returns how many are shown
+  int selectKeysByFingerprints(const QStringList &fingerprints_);
+
   void readPluginSettings();
   void savePluginSettings();
 };
@@ -0,0 +1,85 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGAllocationCounter.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sys/resource.h>
+
+/// local functions
+namespace {
+
+// zero initialized before any dynamic initialization, so allocations of
+// static constructors are counted, too
+std::atomic<quint64> numAllocationsTotal;
+std::atomic<quint64> numBytesTotal;
+
+void *countedAlloc(std::size_t size_) {
+  numAllocationsTotal.fetch_add(1, std::memory_order_relaxed);
+  numBytesTotal.fetch_add(size_, std::memory_order_relaxed);
+  // malloc(0) may return nullptr, operator new must not
+  return std::malloc(size_ ? size_ : 1);
+}
+
+} // namespace
+
+// The replaced operators. The nothrow, sized and array forms of the
+// standard library forward to these.
+void *operator new(std::size_t size_) {
+  void *p = countedAlloc(size_);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](std::size_t size_) { return operator new(size_); }
+
+void operator delete(void *p_) noexcept { std::free(p_); }
+
+void operator delete[](void *p_) noexcept { std::free(p_); }
+
+void operator delete(void *p_, std::size_t) noexcept { std::free(p_); }
+
+void operator delete[](void *p_, std::size_t) noexcept { std::free(p_); }
+
+/// class functions
+GPGAllocationCounter::GPGAllocationCounter() { restart(); }
+
+void GPGAllocationCounter::restart() {
+  m_startAllocations = numAllocationsTotal.load(std::memory_order_relaxed);
+  m_startBytes = numBytesTotal.load(std::memory_order_relaxed);
+}
+
+quint64 GPGAllocationCounter::numAllocations() const {
+  return numAllocationsTotal.load(std::memory_order_relaxed) -
+         m_startAllocations;
+}
+
+quint64 GPGAllocationCounter::numBytes() const {
+  return numBytesTotal.load(std::memory_order_relaxed) - m_startBytes;
+}
+
+qint64 GPGAllocationCounter::peakRssKiB() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return -1;
+  }
+  // KiB on Linux
+  return usage.ru_maxrss;
+}
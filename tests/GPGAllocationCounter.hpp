@@ -0,0 +1,46 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief Counts the heap allocations of a test binary. The .cpp replaces
+ * the global operator new and delete, so it must only be linked into
+ * tests. The counts are process wide, allocations of pool threads
+ * included. A counter reports what was allocated since it was constructed.
+ */
+
+#include <QtGlobal>
+
+class GPGAllocationCounter {
+public:
+  GPGAllocationCounter();
+
+  // since construction
+  quint64 numAllocations() const;
+  quint64 numBytes() const;
+
+  // starts counting again from now
+  void restart();
+
+  // the peak resident set size of the process so far, in KiB
+  static qint64 peakRssKiB();
+
+private:
+  quint64 m_startAllocations;
+  quint64 m_startBytes;
+};
@@ -0,0 +1,158 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGDocumentUpdater.hpp>
+#include <KTextEditor/Document>
+#include <KTextEditor/Editor>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTest>
+#include <memory>
+
+/// local functions
+namespace {
+
+// the size the updater has to handle without setText()
+const int benchmarkSizeBytes = 100 * 1024 * 1024;
+
+QString numberedLines(int numLines_) {
+  QStringList lines;
+  for (auto i = 0; i < numLines_; ++i) {
+    lines << QString("line %1").arg(i);
+  }
+  return lines.join('\n');
+}
+
+} // namespace
+
+class GPGDocumentUpdaterTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+  void cleanup();
+
+  void replaceText_data();
+  void replaceText();
+  void randomEdits();
+  void benchmarkLargeDocument();
+
+private:
+  std::unique_ptr<KTextEditor::Document> m_document;
+};
+
+void GPGDocumentUpdaterTest::init() {
+  m_document.reset(KTextEditor::Editor::instance()->createDocument(nullptr));
+}
+
+void GPGDocumentUpdaterTest::cleanup() { m_document.reset(); }
+
+void GPGDocumentUpdaterTest::replaceText_data() {
+  QTest::addColumn<QString>("oldText");
+  QTest::addColumn<QString>("newText");
+  QTest::addColumn<int>("numChangedLines");
+
+  QTest::newRow("unchanged") << "a\nb\nc" << "a\nb\nc" << 0;
+  QTest::newRow("middle line") << "a\nb\nc" << "a\nx\nc" << 1;
+  QTest::newRow("insert at top") << "a\nb" << "x\na\nb" << 1;
+  QTest::newRow("insert in the middle") << "a\nb" << "a\nx\ny\nb" << 2;
+  QTest::newRow("append") << "a\nb" << "a\nb\nc" << 1;
+  QTest::newRow("trailing newline") << "a\nb" << "a\nb\n" << 1;
+  QTest::newRow("remove at top") << "a\nb\nc" << "b\nc" << 1;
+  QTest::newRow("remove in the middle") << "a\nb\nc\nd" << "a\nd" << 2;
+  QTest::newRow("remove at bottom") << "a\nb\nc" << "a\nb" << 1;
+  QTest::newRow("everything") << "a\nb" << "x\ny\nz" << 3;
+  QTest::newRow("to empty") << "a\nb" << "" << 2;
+  QTest::newRow("from empty") << "" << "a\nb" << 2;
+  QTest::newRow("repeated lines") << "a\na\na" << "a\na" << 1;
+  QString twoEdits = numberedLines(1000);
+  twoEdits.replace("line 10\n", "changed 10\n");
+  twoEdits.replace("line 990\n", "changed 990\n");
+  // not everything from line 10 to line 990
+  QTest::newRow("two edits far apart") << numberedLines(1000) << twoEdits
+                                       << 2;
+  QString moved = numberedLines(1000);
+  moved.replace("line 500\n", QString());
+  moved.append("\nline 500");
+  QTest::newRow("moved line") << numberedLines(1000) << moved << 2;
+}
+
+void GPGDocumentUpdaterTest::replaceText() {
+  QFETCH(QString, oldText);
+  QFETCH(QString, newText);
+  QFETCH(int, numChangedLines);
+  m_document->setText(oldText);
+  QCOMPARE(GPGDocumentUpdater::replaceText(m_document.get(), newText),
+           numChangedLines);
+  QCOMPARE(m_document->text(), newText);
+}
+
+void GPGDocumentUpdaterTest::randomEdits() {
+  // few distinct lines, so there are many repeated (non-anchor) lines
+  QRandomGenerator random(29);
+  const auto randomText = [&random]() {
+    QStringList lines;
+    const int numLines = random.bounded(12);
+    for (auto i = 0; i < numLines; ++i) {
+      lines << QString(random.bounded(4), QChar('a' + random.bounded(3)));
+    }
+    return lines.join('\n');
+  };
+  for (auto i = 0; i < 2000; ++i) {
+    const QString oldText = randomText();
+    const QString newText = randomText();
+    m_document->setText(oldText);
+    GPGDocumentUpdater::replaceText(m_document.get(), newText);
+    QCOMPARE(m_document->text(), newText);
+  }
+}
+
+void GPGDocumentUpdaterTest::benchmarkLargeDocument() {
+  // 64 bytes per line, like base64 armor or a log file
+  const int numLines = benchmarkSizeBytes / 64;
+  QString text;
+  text.reserve(benchmarkSizeBytes);
+  for (auto i = 0; i < numLines; ++i) {
+    text += QString("%1").arg(i, 63, 10, QChar('0'));
+    text += QChar('\n');
+  }
+  QString edited = text;
+  // one edit near the top and one near the bottom
+  edited.replace(64 * (numLines / 4), 5, QString("EDIT1"));
+  edited.replace(64 * (3 * numLines / 4), 5, QString("EDIT2"));
+
+  m_document->setText(text);
+  QElapsedTimer timer;
+  timer.start();
+  const int numChangedLines =
+      GPGDocumentUpdater::replaceText(m_document.get(), edited);
+  const qint64 replaceMs = timer.elapsed();
+  QCOMPARE(numChangedLines, 2);
+  QCOMPARE(m_document->text(), edited);
+
+  m_document->setText(text);
+  timer.restart();
+  m_document->setText(edited);
+  const qint64 setTextMs = timer.elapsed();
+  qInfo("%d MB, 2 lines changed: replaceText() %lld ms, setText() %lld ms",
+        benchmarkSizeBytes / (1024 * 1024), replaceMs, setTextMs);
+}
+
+QTEST_MAIN(GPGDocumentUpdaterTest)
+
+#include "GPGDocumentUpdaterTest.moc"
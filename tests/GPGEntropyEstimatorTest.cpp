@@ -0,0 +1,80 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGEntropyEstimator.hpp>
+#include <QTest>
+
+class GPGEntropyEstimatorTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void emptyInput();
+  void uniformBytes();
+  void smallerThanOneBlock();
+  void sampleSmallerThanBlock();
+  void blocksSpreadOverInput();
+};
+
+void GPGEntropyEstimatorTest::emptyInput() {
+  QCOMPARE(GPGEntropyEstimator::estimateBitsPerByte(QByteArray()), 0.0);
+  QCOMPARE(GPGEntropyEstimator::estimateBitsPerByte(QByteArray("abc"), 0), 0.0);
+}
+
+void GPGEntropyEstimatorTest::uniformBytes() {
+  QByteArray data;
+  for (int i = 0; i < 256 * 64; ++i) {
+    data.append(char(i % 256));
+  }
+  QCOMPARE(GPGEntropyEstimator::estimateBitsPerByte(data), 8.0);
+  QVERIFY(GPGEntropyEstimator::looksIncompressible(data));
+  QCOMPARE(GPGEntropyEstimator::estimateBitsPerByte(QByteArray(1000, 'a')),
+           0.0);
+  QVERIFY(!GPGEntropyEstimator::looksIncompressible(QByteArray(1000, 'a')));
+}
+
+void GPGEntropyEstimatorTest::smallerThanOneBlock() {
+  // larger than the sample, but much smaller than a sample block: only
+  // the first 50 bytes may be looked at, and nothing in front of them
+  const QByteArray data = QByteArray(50, 'a') + QByteArray(50, 'b');
+  QCOMPARE(GPGEntropyEstimator::estimateBitsPerByte(data, 50), 0.0);
+  QCOMPARE(GPGEntropyEstimator::estimateBitsPerByte(data, 100), 1.0);
+}
+
+void GPGEntropyEstimatorTest::sampleSmallerThanBlock() {
+  // the sample must not grow to a full block of 4096 bytes
+  QByteArray data = QByteArray(1000, 'a');
+  for (int i = 0; i < 9000; ++i) {
+    data.append(char(i % 256));
+  }
+  QCOMPARE(GPGEntropyEstimator::estimateBitsPerByte(data, 1000), 0.0);
+}
+
+void GPGEntropyEstimatorTest::blocksSpreadOverInput() {
+  // a compressible header must not decide for a large random looking blob
+  QByteArray data = QByteArray(4096, ' ');
+  for (int i = 0; i < 256 * 4096; ++i) {
+    data.append(char((i * 7) % 256));
+  }
+  const double bitsPerByte =
+      GPGEntropyEstimator::estimateBitsPerByte(data, 16 * 4096);
+  QVERIFY(bitsPerByte > GPGEntropyEstimator::incompressibleBitsPerByte);
+  QVERIFY(bitsPerByte < 8.0);
+}
+
+QTEST_GUILESS_MAIN(GPGEntropyEstimatorTest)
+
+#include "GPGEntropyEstimatorTest.moc"
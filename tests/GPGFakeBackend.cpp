@@ -0,0 +1,398 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGEngineStats.hpp>
+#include <GPGFakeBackend.hpp>
+#include <QCryptographicHash>
+#include <QThread>
+
+/// local functions
+namespace {
+
+const char armorBegin[] = "-----BEGIN PGP MESSAGE-----";
+const char armorEnd[] = "-----END PGP MESSAGE-----";
+
+const int tagPKESK = 1;
+const int tagSKESK = 3;
+const int tagSEIPD = 18;
+
+// 2023-01-01, the made up keys are created an hour apart from here on
+const qint64 fakeEpoch = 1672531200;
+
+bool isHex(const QString &text_) {
+  for (auto c : text_) {
+    const char l = c.toLatin1();
+    if (!((l >= '0' && l <= '9') || (l >= 'a' && l <= 'f') ||
+          (l >= 'A' && l <= 'F'))) {
+      return false;
+    }
+  }
+  return !text_.isEmpty();
+}
+
+// a new format packet, always with a 4 byte length
+QByteArray packet(int tag_, const QByteArray &body_) {
+  const quint32 length = quint32(body_.size());
+  QByteArray p;
+  p.append(char(0xC0 | tag_));
+  p.append(char(0xFF));
+  p.append(char(length >> 24));
+  p.append(char(length >> 16));
+  p.append(char(length >> 8));
+  p.append(char(length));
+  return p + body_;
+}
+
+struct FakeMessage {
+  QStringList recipientKeyIDs;
+  QString signerFingerprint;
+  QString text;
+};
+
+// reads what GPGFakeBackend::armor() wrote
+bool readFakeMessage(const QString &armored_, FakeMessage &message_) {
+  QStringList lines = armored_.trimmed().split('\n');
+  if (lines.size() < 3 || lines.first() != armorBegin ||
+      lines.last() != armorEnd) {
+    return false;
+  }
+  const QByteArray binary = QByteArray::fromBase64(
+      lines.mid(1, lines.size() - 2).join(QString()).toLatin1());
+  int pos = 0;
+  while (pos + 6 <= binary.size()) {
+    const int tag = binary.at(pos) & 0x3f;
+    const uchar *l = reinterpret_cast<const uchar *>(binary.constData()) + pos;
+    const int length = int((quint32(l[2]) << 24) | (quint32(l[3]) << 16) |
+                           (quint32(l[4]) << 8) | quint32(l[5]));
+    pos += 6;
+    if (uchar(l[0]) != (0xC0 | tag) || uchar(l[1]) != 0xFF ||
+        length > binary.size() - pos) {
+      return false;
+    }
+    const QByteArray body = binary.mid(pos, length);
+    pos += length;
+    if (tag == tagPKESK) {
+      message_.recipientKeyIDs.append(
+          QString::fromLatin1(body.mid(1, 8).toHex().toUpper()));
+    } else if (tag == tagSEIPD) {
+      // version, signer, newline, text
+      const int eol = body.indexOf('\n');
+      if (eol < 1) {
+        return false;
+      }
+      message_.signerFingerprint = QString::fromLatin1(body.mid(1, eol - 1));
+      message_.text = QString::fromUtf8(body.mid(eol + 1));
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+/// class functions
+GPGFakeBackend::GPGFakeBackend(int numKeys_, int latencyMs_)
+    : m_numKeys(numKeys_), m_latencyMs(latencyMs_) {}
+
+GPGFakeBackend::~GPGFakeBackend() {}
+
+void GPGFakeBackend::setNumKeys(int numKeys_) {
+  m_numKeys.storeRelaxed(numKeys_);
+}
+
+int GPGFakeBackend::numKeys() const { return m_numKeys.loadRelaxed(); }
+
+void GPGFakeBackend::setLatency(int latencyMs_) {
+  m_latencyMs.storeRelaxed(latencyMs_);
+}
+
+int GPGFakeBackend::latency() const { return m_latencyMs.loadRelaxed(); }
+
+void GPGFakeBackend::wait() const {
+  if (latency() > 0) {
+    QThread::msleep(ulong(latency()));
+  }
+}
+
+GPGKeyDetails GPGFakeBackend::makeKey(int index_,
+                                      std::shared_ptr<GPGStringArena> arena_) {
+  const QString fingerprint = QString::fromLatin1(
+      QCryptographicHash::hash(QByteArray::number(index_),
+                               QCryptographicHash::Sha1)
+          .toHex()
+          .toUpper());
+  QVector<QString> uids;
+  QVector<QString> mails;
+  uids << QString("Test User %1").arg(index_);
+  mails << QString("user%1@example.org").arg(index_);
+  // some keys have a second user ID, like real keyrings
+  if (index_ % 7 == 0) {
+    uids << QString("Test User %1 (work)").arg(index_);
+    mails << QString("user%1@work.example.com").arg(index_);
+  }
+  const qint64 creationTime = fakeEpoch + qint64(index_) * 3600;
+  // every 13th key has expired a day after it was created
+  const qint64 expiryTime = index_ % 13 == 0 ? creationTime + 86400 : 0;
+  GPGKeyDetails d;
+  d.loadFromValues(fingerprint, index_ % 3 ? "ed25519" : "rsa",
+                   index_ % 3 ? 255 : 4096, creationTime, expiryTime, uids,
+                   mails,
+                   arena_ ? arena_ : std::make_shared<GPGStringArena>(1024));
+  return d;
+}
+
+GPGKeyListing GPGFakeBackend::listKeySnapshot() {
+  GPGEngineStats::record(GPGEngineOp::KeyListing);
+  wait();
+  QMutexLocker locker(&m_keyringMutex);
+  // the details share the keyring's arena, nothing is copied
+  return keyring();
+}
+
+const GPGKeyListing &GPGFakeBackend::keyring() {
+  const int numKeys = this->numKeys();
+  if (m_keyring.details.size() == numKeys) {
+    return m_keyring;
+  }
+  m_keyring = GPGKeyListing();
+  m_fingerprintIndex.clear();
+  m_keyIDIndex.clear();
+  m_mailIndex.clear();
+  m_keyring.details.reserve(numKeys);
+  auto arena = std::make_shared<GPGStringArena>();
+  for (auto i = 0; i < numKeys; ++i) {
+    const GPGKeyDetails d = makeKey(i, arena);
+    m_keyring.details.append(d);
+    m_fingerprintIndex.insert(d.fingerPrint(), i);
+    m_keyIDIndex.insert(d.fingerPrintView().right(16).toString(), i);
+    for (auto &mail : d.mailAdresses()) {
+      m_mailIndex[GPGKeyDetails::normalizedMailAddress(mail)].append(i);
+    }
+    // every 10th key has a private key
+    if (i % 10 == 0) {
+      m_keyring.secretFingerprints.insert(d.fingerPrint());
+    }
+  }
+  return m_keyring;
+}
+
+QVector<int> GPGFakeBackend::findKeys(const QString &pattern_) {
+  const GPGKeyListing &keyring = this->keyring();
+  const QString pattern = pattern_.trimmed();
+  if (pattern.startsWith(QLatin1Char('<')) &&
+      pattern.endsWith(QLatin1Char('>'))) {
+    return m_mailIndex.value(GPGKeyDetails::normalizedMailAddress(pattern));
+  }
+  QString hexPattern = pattern;
+  if (hexPattern.startsWith(QLatin1String("0x"), Qt::CaseInsensitive)) {
+    hexPattern = hexPattern.mid(2);
+  }
+  if (isHex(hexPattern) &&
+      (hexPattern.size() == 40 || hexPattern.size() == 16)) {
+    const QHash<QString, int> &index =
+        hexPattern.size() == 40 ? m_fingerprintIndex : m_keyIDIndex;
+    auto it = index.constFind(hexPattern.toUpper());
+    return it == index.constEnd() ? QVector<int>() : QVector<int>{it.value()};
+  }
+  // parts of a user ID (or a short key ID) need a scan, like in gpg
+  GPGKeyFilter filter;
+  filter.searchPattern = pattern;
+  QVector<int> found;
+  for (auto i = 0; i < keyring.details.size(); ++i) {
+    if (filter.accepts(keyring.details.at(i))) {
+      found.append(i);
+    }
+  }
+  return found;
+}
+
+QVector<QStringList>
+GPGFakeBackend::lookupKeyFingerprints(const QStringList &patterns_) {
+  GPGEngineStats::record(GPGEngineOp::KeyLookup);
+  wait();
+  QMutexLocker locker(&m_keyringMutex);
+  QVector<QStringList> result(patterns_.size());
+  for (auto i = 0; i < patterns_.size(); ++i) {
+    for (auto k : findKeys(patterns_.at(i))) {
+      result[i].append(m_keyring.details.at(k).fingerPrint());
+    }
+  }
+  return result;
+}
+
+QString GPGFakeBackend::armor(const QString &inputString_,
+                              const QStringList &fingerprints_,
+                              const QString &signerFingerprint_) {
+  QByteArray binary;
+  for (auto &fingerprint : fingerprints_) {
+    // v3, key ID, RSA, a one byte session key "MPI"
+    binary += packet(tagPKESK, QByteArray(1, 3) +
+                                   QByteArray::fromHex(
+                                       fingerprint.right(16).toLatin1()) +
+                                   QByteArray("\x01\x00\x08\x01", 4));
+  }
+  if (fingerprints_.isEmpty()) {
+    // v4, AES256, simple S2K with SHA256
+    binary += packet(tagSKESK, QByteArray("\x04\x09\x00\x08", 4));
+  }
+  binary += packet(tagSEIPD, QByteArray(1, 1) +
+                                 signerFingerprint_.toLatin1() + '\n' +
+                                 inputString_.toUtf8());
+  const QByteArray base64 = binary.toBase64();
+  QString armored = QString(armorBegin) + "\n\n";
+  for (auto i = 0; i < base64.size(); i += 64) {
+    armored += QString::fromLatin1(base64.mid(i, 64)) + "\n";
+  }
+  return armored + armorEnd + "\n";
+}
+
+const GPGOperationResult
+GPGFakeBackend::encryptString(const QString &inputString_,
+                              const QString &fingerprint_,
+                              const QString &recipientMail_,
+                              bool symmetricEncryption_) {
+  if (symmetricEncryption_) {
+    GPGEngineStats::record(GPGEngineOp::Encrypt);
+    wait();
+    GPGOperationResult result;
+    result.keyFound = true;
+    result.decryptionSuccess = true;
+    result.resultString = armor(inputString_, QStringList());
+    return result;
+  }
+  {
+    QMutexLocker locker(&m_keyringMutex);
+    keyring();
+    const int index =
+        m_fingerprintIndex.value(fingerprint_.trimmed().toUpper(), -1);
+    if (index < 0 ||
+        (!recipientMail_.isEmpty() &&
+         !m_keyring.details.at(index).hasMailAddress(recipientMail_))) {
+      // gpg gives up after looking for the key
+      GPGEngineStats::record(GPGEngineOp::KeyLookup);
+      wait();
+      GPGOperationResult result;
+      result.errorMessage.append("No key found for " + recipientMail_);
+      return result;
+    }
+  }
+  return encryptStringToRecipients(inputString_,
+                                   QStringList() << fingerprint_);
+}
+
+const GPGOperationResult
+GPGFakeBackend::encryptStringToRecipients(const QString &inputString_,
+                                          const QStringList &fingerprints_) {
+  GPGEngineStats::record(GPGEngineOp::Encrypt);
+  wait();
+  GPGOperationResult result;
+  if (fingerprints_.isEmpty()) {
+    result.errorMessage = "No recipients.";
+    return result;
+  }
+  {
+    QMutexLocker locker(&m_keyringMutex);
+    keyring();
+    for (auto &fingerprint : fingerprints_) {
+      if (!m_fingerprintIndex.contains(fingerprint.trimmed().toUpper())) {
+        result.errorMessage.append("Not all recipient keys were found.");
+        return result;
+      }
+    }
+  }
+  result.keyFound = true;
+  result.decryptionSuccess = true;
+  result.resultString = armor(inputString_, fingerprints_);
+  return result;
+}
+
+const GPGOperationResult
+GPGFakeBackend::signAndEncrypt(const QString &inputString_,
+                               const QStringList &fingerprints_,
+                               bool symmetricEncryption_) {
+  GPGOperationResult result =
+      symmetricEncryption_
+          ? encryptString(inputString_, QString(), QString(), true)
+          : encryptStringToRecipients(inputString_, fingerprints_);
+  if (!result.decryptionSuccess) {
+    return result;
+  }
+  // key 0 always has a private key, see keyring()
+  result.signerFingerprint = makeKey(0).fingerPrint();
+  result.signatureFound = true;
+  result.signatureValid = true;
+  result.signatureSummary = "Signed with " + result.signerFingerprint;
+  result.resultString =
+      armor(inputString_, symmetricEncryption_ ? QStringList() : fingerprints_,
+            result.signerFingerprint);
+  return result;
+}
+
+const GPGOperationResult
+GPGFakeBackend::decryptString(const QString &inputString_) {
+  // also for decryptAndVerify(), gpg verifies in the same run
+  GPGEngineStats::record(GPGEngineOp::Decrypt);
+  wait();
+  GPGOperationResult result;
+  FakeMessage message;
+  if (!readFakeMessage(inputString_, message)) {
+    result.errorMessage = "Not a fake message.";
+    return result;
+  }
+  // no recipients for "symmetric" messages
+  if (!message.recipientKeyIDs.isEmpty()) {
+    QMutexLocker locker(&m_keyringMutex);
+    keyring();
+    // like gpg, the first recipient we have the secret key of
+    for (auto &keyID : message.recipientKeyIDs) {
+      const int index = m_keyIDIndex.value(keyID, -1);
+      const QString fingerprint =
+          index >= 0 ? m_keyring.details.at(index).fingerPrint() : QString();
+      if (m_keyring.secretFingerprints.contains(fingerprint)) {
+        result.fingerprintUsedForDecryption = fingerprint;
+        result.keyIDUsedForDecryption = keyID;
+        break;
+      }
+    }
+    if (result.fingerprintUsedForDecryption.isEmpty()) {
+      result.errorMessage = "No secret key.";
+      return result;
+    }
+  }
+  result.keyFound = true;
+  result.decryptionSuccess = true;
+  result.resultString = message.text;
+  return result;
+}
+
+const GPGOperationResult
+GPGFakeBackend::decryptAndVerify(const QString &inputString_) {
+  GPGOperationResult result = decryptString(inputString_);
+  if (!result.decryptionSuccess) {
+    return result;
+  }
+  FakeMessage message;
+  readFakeMessage(inputString_, message);
+  const QString signer = message.signerFingerprint;
+  result.signatureFound = !signer.isEmpty();
+  result.signatureValid = result.signatureFound;
+  result.signerFingerprint = signer;
+  if (result.signatureFound) {
+    result.signatureSummary = "Good signature from " + signer;
+  }
+  return result;
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/**
+ * @brief An in-memory stand-in for gpg, for exercising the toolview with
+ * keyrings of any size without a GnuPG home directory. The keys are made
+ * up deterministically from their index, so every run sees the same
+ * keyring. They are made once per keyring size and indexed by
+ * fingerprint, key ID and mail address. Each operation can be slowed
+ * down by a fixed latency to mimic the gpg round trip.
+ *
+ * "Encryption" only wraps the text in OpenPGP packets: a session key
+ * packet per recipient, so GPGPacketParser finds them, and a data packet
+ * holding the text in the clear. It is NOT encryption and only meant for
+ * tests.
+ */
+
+#include <GPGBackend.hpp>
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+
+class GPGFakeBackend : public GPGBackend {
+public:
+  /**
+   * @param numKeys_ The size of the made up keyring.
+   * @param latencyMs_ Added to every operation.
+   */
+  explicit GPGFakeBackend(int numKeys_ = 1000, int latencyMs_ = 0);
+
+  ~GPGFakeBackend() override;
+
+  void setNumKeys(int numKeys_);
+  int numKeys() const;
+
+  void setLatency(int latencyMs_);
+  int latency() const;
+
+  // the made up details of key number index_ (0 <= index_ < numKeys()),
+  // in an arena of its own if none is given (for single keys only)
+  static GPGKeyDetails makeKey(int index_,
+                               std::shared_ptr<GPGStringArena> arena_ = nullptr);
+
+  GPGKeyListing listKeySnapshot() override;
+
+  QVector<QStringList>
+  lookupKeyFingerprints(const QStringList &patterns_) override;
+
+  const GPGOperationResult encryptString(const QString &inputString_,
+                                         const QString &fingerprint_,
+                                         const QString &recipientMail_,
+                                         bool symmetricEncryption_ = false) override;
+
+  const GPGOperationResult
+  encryptStringToRecipients(const QString &inputString_,
+                            const QStringList &fingerprints_) override;
+
+  // "signs" with the first key that has a private key
+  const GPGOperationResult signAndEncrypt(const QString &inputString_,
+                                          const QStringList &fingerprints_,
+                                          bool symmetricEncryption_ = false) override;
+
+  const GPGOperationResult decryptString(const QString &inputString_) override;
+
+  const GPGOperationResult
+  decryptAndVerify(const QString &inputString_) override;
+
+private:
+  // set once, read by listKeySnapshot() on the worker thread
+  QAtomicInt m_numKeys;
+  QAtomicInt m_latencyMs;
+
+  // the made up keyring, rebuilt by keyring() when numKeys() changed
+  QMutex m_keyringMutex;
+  GPGKeyListing m_keyring;
+  QHash<QString, int> m_fingerprintIndex;  // upper case
+  QHash<QString, int> m_keyIDIndex;        // 16 digits, upper case
+  QHash<QString, QVector<int>> m_mailIndex; // normalized mail address
+
+  void wait() const;
+
+  // builds the keyring if needed, call with m_keyringMutex locked
+  const GPGKeyListing &keyring();
+
+  // the indices of the keys a lookup pattern matches
+  QVector<int> findKeys(const QString &pattern_);
+
+  // wraps the text in the fake packets and an armor
+  static QString armor(const QString &inputString_,
+                       const QStringList &fingerprints_,
+                       const QString &signerFingerprint_ = QString());
+};
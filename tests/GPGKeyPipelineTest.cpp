@@ -0,0 +1,139 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGAllocationCounter.hpp>
+#include <GPGFakeBackend.hpp>
+#include <GPGKeyPipeline.hpp>
+#include <QTest>
+#include <QThread>
+
+/// local functions
+namespace {
+
+// enough batches to keep every converter busy
+const int numBenchmarkKeys = 100000;
+
+// lists the made up keys 0 .. numKeys_ - 1 through the pipeline
+QVector<GPGKeyDetails> listFakeKeys(int numKeys_, int numConverters_) {
+  int next = 0;
+  std::vector<int> keys;
+  QVector<GPGKeyDetails> details;
+  GPGKeyPipeline::run<int>(
+      [&next, numKeys_](int &key_) {
+        key_ = next++;
+        return key_ < numKeys_;
+      },
+      [](const int &key_, const std::shared_ptr<GPGStringArena> &arena_) {
+        return GPGFakeBackend::makeKey(key_, arena_);
+      },
+      keys, details, numConverters_);
+  return details;
+}
+
+} // namespace
+
+class GPGKeyPipelineTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+
+  void listingOrder_data();
+  void listingOrder();
+  void converterSpeedup_data();
+  void converterSpeedup();
+  void arenaPerBatch();
+};
+
+void GPGKeyPipelineTest::initTestCase() {
+  qInfo("%d cores, %d converters by default", QThread::idealThreadCount(),
+        GPGKeyPipeline::defaultNumConverters());
+}
+
+void GPGKeyPipelineTest::listingOrder_data() {
+  QTest::addColumn<int>("numKeys");
+  QTest::addColumn<int>("numConverters");
+
+  QTest::newRow("empty") << 0 << 2;
+  // converted by the producer alone
+  QTest::newRow("less than one batch") << GPGKeyPipeline::batchSize - 1 << 2;
+  QTest::newRow("one batch") << GPGKeyPipeline::batchSize << 2;
+  // more batches than the queue holds
+  QTest::newRow("one converter") << 10000 << 1;
+  QTest::newRow("four converters") << 10000 << 4;
+}
+
+void GPGKeyPipelineTest::listingOrder() {
+  QFETCH(int, numKeys);
+  QFETCH(int, numConverters);
+  const QVector<GPGKeyDetails> details = listFakeKeys(numKeys, numConverters);
+  QCOMPARE(details.size(), numKeys);
+  for (auto i = 0; i < numKeys; ++i) {
+    QCOMPARE(details.at(i).fingerPrint(),
+             GPGFakeBackend::makeKey(i).fingerPrint());
+  }
+}
+
+void GPGKeyPipelineTest::converterSpeedup_data() {
+  QTest::addColumn<int>("numConverters");
+  // up to one more than the cores, to see where it stops scaling
+  const int maxConverters = QThread::idealThreadCount() + 1;
+  for (auto n = 1; n <= maxConverters; ++n) {
+    QTest::newRow(qPrintable(QString("%1 converters").arg(n))) << n;
+  }
+}
+
+void GPGKeyPipelineTest::converterSpeedup() {
+  QFETCH(int, numConverters);
+  QBENCHMARK {
+    QCOMPARE(listFakeKeys(numBenchmarkKeys, numConverters).size(),
+             numBenchmarkKeys);
+  }
+}
+
+void GPGKeyPipelineTest::arenaPerBatch() {
+  const int numKeys = 10000;
+  // what every key used to cost without a shared arena
+  GPGAllocationCounter allocations;
+  {
+    QVector<GPGKeyDetails> details;
+    details.reserve(numKeys);
+    for (auto i = 0; i < numKeys; ++i) {
+      details.append(GPGFakeBackend::makeKey(
+          i, std::make_shared<GPGStringArena>(1024)));
+    }
+  }
+  const quint64 ownArenas = allocations.numAllocations();
+  allocations.restart();
+  QCOMPARE(listFakeKeys(numKeys, 1).size(), numKeys);
+  const quint64 sharedArenas = allocations.numAllocations();
+  qInfo("%d keys: %.1f allocations per key with an arena each, %.1f with "
+        "one per batch, peak RSS %lld KiB",
+        numKeys, double(ownArenas) / numKeys, double(sharedArenas) / numKeys,
+        GPGAllocationCounter::peakRssKiB());
+  // the shared arena and its chunk list, for every key (the chunks come
+  // from malloc() and only show in the peak RSS)
+  QVERIFY2(sharedArenas + 2 * quint64(numKeys) <= ownArenas,
+           qPrintable(QString("%1 allocations with an arena per batch, %2 "
+                              "with one per key")
+                          .arg(sharedArenas)
+                          .arg(ownArenas)));
+}
+
+QTEST_MAIN(GPGKeyPipelineTest)
+
+#include "GPGKeyPipelineTest.moc"
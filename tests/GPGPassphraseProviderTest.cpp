@@ -0,0 +1,138 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGPassphraseProvider.hpp>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <cstdlib>
+
+class GPGPassphraseProviderTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void init();
+
+  void keptPerKeyWithinBatch();
+  void askedAgainAfterBatch();
+  void badPassphraseOnlyForgetsItsKey();
+
+private:
+  QTemporaryDir m_dir;
+  QString m_fileName;
+
+  // what the "user" would type in next
+  void setPassphrase(const QByteArray &passphrase_);
+
+  // the passphrase the provider hands to gpgme, "<canceled>" if none
+  static QByteArray passphraseFor(GPGPassphraseProvider &provider_,
+                                  const char *useridHint_,
+                                  bool previousWasBad_ = false);
+};
+
+void GPGPassphraseProviderTest::init() {
+  QVERIFY(m_dir.isValid());
+  m_fileName = m_dir.filePath("passphrase");
+  setPassphrase("first");
+}
+
+void GPGPassphraseProviderTest::setPassphrase(const QByteArray &passphrase_) {
+  QFile file(m_fileName);
+  QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+  file.write(passphrase_ + "\n");
+}
+
+QByteArray
+GPGPassphraseProviderTest::passphraseFor(GPGPassphraseProvider &provider_,
+                                         const char *useridHint_,
+                                         bool previousWasBad_) {
+  bool canceled = false;
+  char *passphrase = provider_.getPassphrase(useridHint_, "", previousWasBad_,
+                                             canceled);
+  if (canceled || !passphrase) {
+    return "<canceled>";
+  }
+  const QByteArray result(passphrase);
+  std::free(passphrase);
+  return result;
+}
+
+void GPGPassphraseProviderTest::keptPerKeyWithinBatch() {
+  GPGPassphraseProvider provider;
+  provider.setPassphraseFile(m_fileName);
+  GPGPassphraseProvider::BatchScope batch(&provider);
+  QCOMPARE(passphraseFor(provider, "AAAAAAAAAAAAAAAA Alice <a@example.org>"),
+           QByteArray("first"));
+  if (provider.numKeptPassphrases() == 0) {
+    QSKIP("no memory can be locked here, nothing is kept");
+  }
+  setPassphrase("second");
+  // the same key, maybe under another user ID
+  QCOMPARE(passphraseFor(provider, "AAAAAAAAAAAAAAAA Alice <a@work.org>"),
+           QByteArray("first"));
+  // another key of the batch is asked for, not given Alice's passphrase
+  QCOMPARE(passphraseFor(provider, "BBBBBBBBBBBBBBBB Bob <b@example.org>"),
+           QByteArray("second"));
+  setPassphrase("third");
+  QCOMPARE(passphraseFor(provider, "AAAAAAAAAAAAAAAA Alice <a@example.org>"),
+           QByteArray("first"));
+  QCOMPARE(passphraseFor(provider, "BBBBBBBBBBBBBBBB Bob <b@example.org>"),
+           QByteArray("second"));
+  QCOMPARE(provider.numKeptPassphrases(), 2);
+}
+
+void GPGPassphraseProviderTest::askedAgainAfterBatch() {
+  GPGPassphraseProvider provider;
+  provider.setPassphraseFile(m_fileName);
+  {
+    GPGPassphraseProvider::BatchScope batch(&provider);
+    QCOMPARE(passphraseFor(provider, "AAAAAAAAAAAAAAAA Alice"),
+             QByteArray("first"));
+  }
+  QCOMPARE(provider.numKeptPassphrases(), 0);
+  setPassphrase("second");
+  QCOMPARE(passphraseFor(provider, "AAAAAAAAAAAAAAAA Alice"),
+           QByteArray("second"));
+  // outside of a batch nothing is kept
+  QCOMPARE(provider.numKeptPassphrases(), 0);
+}
+
+void GPGPassphraseProviderTest::badPassphraseOnlyForgetsItsKey() {
+  GPGPassphraseProvider provider;
+  provider.setPassphraseFile(m_fileName);
+  GPGPassphraseProvider::BatchScope batch(&provider);
+  QCOMPARE(passphraseFor(provider, "AAAAAAAAAAAAAAAA Alice"),
+           QByteArray("first"));
+  QCOMPARE(passphraseFor(provider, "BBBBBBBBBBBBBBBB Bob"),
+           QByteArray("first"));
+  if (provider.numKeptPassphrases() == 0) {
+    QSKIP("no memory can be locked here, nothing is kept");
+  }
+  // a file can not do better the second time
+  QCOMPARE(passphraseFor(provider, "AAAAAAAAAAAAAAAA Alice", true),
+           QByteArray("<canceled>"));
+  QCOMPARE(provider.numKeptPassphrases(), 1);
+  setPassphrase("second");
+  QCOMPARE(passphraseFor(provider, "AAAAAAAAAAAAAAAA Alice"),
+           QByteArray("second"));
+  QCOMPARE(passphraseFor(provider, "BBBBBBBBBBBBBBBB Bob"),
+           QByteArray("first"));
+}
+
+QTEST_MAIN(GPGPassphraseProviderTest)
+
+#include "GPGPassphraseProviderTest.moc"
@@ -0,0 +1,192 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGRecipientScanner.hpp>
+#include <QRandomGenerator>
+#include <QTest>
+#include <algorithm>
+
+/// local functions
+namespace {
+
+// 2023-01-01, and a day later for the expired keys
+const qint64 creationTime = 1672531200;
+const qint64 expiredTime = creationTime + 86400;
+
+GPGKeyDetails makeKey(const std::shared_ptr<GPGStringArena> &arena_,
+                      int index_, const QVector<QString> &mails_,
+                      bool expired_ = false) {
+  QVector<QString> uids;
+  for (auto i = 0; i < mails_.size(); ++i) {
+    uids << QString("User %1").arg(index_);
+  }
+  GPGKeyDetails key;
+  key.loadFromValues(QString("%1").arg(index_, 40, 16, QChar('0')).toUpper(),
+                     "ed25519", 255, creationTime,
+                     expired_ ? expiredTime : 0, uids, mails_, arena_);
+  return key;
+}
+
+bool isAddressChar(QChar c_) {
+  return c_.isLetterOrNumber() || QString("._%+-@").contains(c_);
+}
+
+// the same rules as GPGRecipientScanner::scan(), one address at a time
+QStringList naiveScan(const QVector<GPGKeyDetails> &keys_,
+                      const QString &text_) {
+  struct Match {
+    int end;
+    int length;
+    QString fingerprint;
+  };
+  QVector<Match> matches;
+  const QString text = text_.toCaseFolded();
+  for (auto &key : keys_) {
+    if (key.isExpired()) {
+      continue;
+    }
+    for (auto &mail : key.mailAdresses()) {
+      const QString address = GPGKeyDetails::normalizedMailAddress(mail);
+      if (address.isEmpty()) {
+        continue;
+      }
+      for (int start = text.indexOf(address); start >= 0;
+           start = text.indexOf(address, start + 1)) {
+        int end = start + address.size();
+        const int matchEnd = end;
+        if (start > 0 && isAddressChar(text.at(start - 1))) {
+          continue;
+        }
+        if (end < text.size() && text.at(end) == QLatin1Char('.')) {
+          ++end;
+        }
+        if (end < text.size() && isAddressChar(text.at(end))) {
+          continue;
+        }
+        matches.append({matchEnd, int(address.size()), key.fingerPrint()});
+      }
+    }
+  }
+  // in the order they end, the longest of those ending at the same place
+  // first, then in key order
+  std::stable_sort(matches.begin(), matches.end(),
+                   [](const Match &a_, const Match &b_) {
+                     return a_.end != b_.end ? a_.end < b_.end
+                                             : a_.length > b_.length;
+                   });
+  QStringList fingerprints;
+  for (auto &match : matches) {
+    if (!fingerprints.contains(match.fingerprint)) {
+      fingerprints << match.fingerprint;
+    }
+  }
+  return fingerprints;
+}
+
+} // namespace
+
+class GPGRecipientScannerTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void scan_data();
+  void scan();
+  void randomTexts();
+};
+
+void GPGRecipientScannerTest::scan_data() {
+  QTest::addColumn<QString>("mail");
+  QTest::addColumn<QString>("text");
+  QTest::addColumn<bool>("found");
+
+  QTest::newRow("exact") << "bob@example.org" << "To: bob@example.org"
+                         << true;
+  QTest::newRow("case") << "Bob@Example.org" << "To: BOB@EXAMPLE.ORG"
+                        << true;
+  QTest::newRow("angle brackets") << "bob@example.org"
+                                  << "Bob <bob@example.org>" << true;
+  QTest::newRow("end of sentence") << "bob@example.org"
+                                   << "Write to bob@example.org." << true;
+  QTest::newRow("longer address") << "bob@example.org"
+                                  << "jimbob@example.org" << false;
+  QTest::newRow("longer domain") << "bob@example.org"
+                                 << "bob@example.org.uk" << false;
+  // folds to a different length than it has (if Qt folds it fully)
+  QTest::newRow("sharp s") << "straße@example.org"
+                           << "To: STRASSE@EXAMPLE.ORG, straße@example.org"
+                           << true;
+  QTest::newRow("greek final sigma") << "ΟΔΥΣΣΕΥΣ@example.org"
+                                     << "οδυσσευς@example.org" << true;
+  // a surrogate pair, folded as one code point
+  QTest::newRow("deseret") << QString::fromUtf8("\xf0\x90\x90\x80@example.org")
+                           << QString::fromUtf8("\xf0\x90\x90\xa8@example.org")
+                           << true;
+}
+
+void GPGRecipientScannerTest::scan() {
+  QFETCH(QString, mail);
+  QFETCH(QString, text);
+  QFETCH(bool, found);
+  const QVector<GPGKeyDetails> keys{
+      makeKey(std::make_shared<GPGStringArena>(), 1, {mail})};
+  GPGRecipientScanner scanner;
+  scanner.build(keys);
+  const QStringList expected =
+      found ? QStringList{keys.first().fingerPrint()} : QStringList();
+  QCOMPARE(scanner.scan(text), expected);
+  QCOMPARE(naiveScan(keys, text), expected);
+}
+
+void GPGRecipientScannerTest::randomTexts() {
+  // A small alphabet, so addresses overlap, share suffixes and occur
+  // inside each other. Mixed case, 'ß' and a surrogate pair on both
+  // sides.
+  const QString alphabet =
+      QString("aAbB.@ ß") + QString::fromUtf8("\xf0\x90\x90\x80");
+  QRandomGenerator random(42);
+  const auto randomString = [&random, &alphabet](int maxLength_) {
+    QString s;
+    const int length = random.bounded(1, maxLength_ + 1);
+    for (auto i = 0; i < length; ++i) {
+      const int c = random.bounded(alphabet.size() - 1);
+      // the last two code units are one surrogate pair
+      s += c == alphabet.size() - 2 ? alphabet.right(2) : alphabet.mid(c, 1);
+    }
+    return s;
+  };
+  for (auto round = 0; round < 2000; ++round) {
+    const auto arena = std::make_shared<GPGStringArena>(1024);
+    QVector<GPGKeyDetails> keys;
+    const int numKeys = random.bounded(1, 6);
+    for (auto k = 0; k < numKeys; ++k) {
+      QVector<QString> mails;
+      const int numMails = random.bounded(1, 3);
+      for (auto m = 0; m < numMails; ++m) {
+        mails << randomString(4).trimmed() + "@" + randomString(3).trimmed();
+      }
+      keys << makeKey(arena, k, mails, random.bounded(5) == 0);
+    }
+    const QString text = randomString(60);
+    GPGRecipientScanner scanner;
+    scanner.build(keys);
+    QCOMPARE(scanner.scan(text), naiveScan(keys, text));
+  }
+}
+
+QTEST_MAIN(GPGRecipientScannerTest)
+
+#include "GPGRecipientScannerTest.moc"
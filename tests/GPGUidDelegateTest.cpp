@@ -0,0 +1,88 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGKeyDetails.hpp>
+#include <GPGUidDelegate.hpp>
+#include <QTest>
+
+/// local functions
+namespace {
+
+GPGKeyDetails makeKey(int index_, int numUids_) {
+  // a single key, an arena of its own is fine
+  const auto arena = std::make_shared<GPGStringArena>(1024);
+  QVector<QString> uids;
+  QVector<QString> mails;
+  for (auto i = 0; i < numUids_; ++i) {
+    uids << QString("Test User %1.%2").arg(index_).arg(i);
+    mails << QString("user%1.%2@example.org").arg(index_).arg(i);
+  }
+  GPGKeyDetails key;
+  // 2023-01-01
+  key.loadFromValues(QString("%1").arg(index_, 40, 16, QChar('0')).toUpper(),
+                     "ed25519", 255, 1672531200, 0, uids, mails, arena);
+  return key;
+}
+
+} // namespace
+
+class GPGUidDelegateTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void uidLinesEqualToKey_data();
+  void uidLinesEqualToKey();
+  void otherKeyNotEqual();
+};
+
+void GPGUidDelegateTest::uidLinesEqualToKey_data() {
+  QTest::addColumn<int>("numUids");
+
+  QTest::newRow("one user ID") << 1;
+  QTest::newRow("two user IDs") << 2;
+  QTest::newRow("more than shown") << GPGUidDelegate::maxVisibleLines + 2;
+}
+
+void GPGUidDelegateTest::uidLinesEqualToKey() {
+  QFETCH(int, numUids);
+  const GPGKeyDetails key = makeKey(1, numUids);
+  const QStringList lines = GPGUidDelegate::uidLines(key);
+  QCOMPARE(lines.size(), numUids);
+  QVERIFY(GPGUidDelegate::uidLinesEqual(lines, key));
+
+  QStringList longer = lines;
+  longer.last().append(' ');
+  QVERIFY(!GPGUidDelegate::uidLinesEqual(longer, key));
+  QStringList shorter = lines;
+  shorter.last().chop(1);
+  QVERIFY(!GPGUidDelegate::uidLinesEqual(shorter, key));
+  QStringList changed = lines;
+  changed.last().replace('<', '[');
+  QVERIFY(!GPGUidDelegate::uidLinesEqual(changed, key));
+  QVERIFY(!GPGUidDelegate::uidLinesEqual(lines.mid(1), key));
+  QVERIFY(!GPGUidDelegate::uidLinesEqual(lines + lines.mid(0, 1), key));
+}
+
+void GPGUidDelegateTest::otherKeyNotEqual() {
+  // the same number of user IDs, different text
+  QVERIFY(!GPGUidDelegate::uidLinesEqual(
+      GPGUidDelegate::uidLines(makeKey(1, 2)), makeKey(2, 2)));
+}
+
+QTEST_MAIN(GPGUidDelegateTest)
+
+#include "GPGUidDelegateTest.moc"
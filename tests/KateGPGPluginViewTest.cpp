@@ -0,0 +1,330 @@
+/*
+ * This file is part of kate-gpg-plugin (https://github.com/dennis2society).
+ * Copyright (c) 2023 Dennis Luebke.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <GPGAllocationCounter.hpp>
+#include <GPGEngineStats.hpp>
+#include <GPGFakeBackend.hpp>
+#include <GPGKeyLoader.hpp>
+#include <KTextEditor/Document>
+#include <KTextEditor/Editor>
+#include <KTextEditor/MainWindow>
+#include <KTextEditor/View>
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QIcon>
+#include <QLineEdit>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTableWidget>
+#include <QTemporaryDir>
+#include <QTest>
+#include <kate_gpg_plugin.hpp>
+#include <memory>
+
+/// local functions
+namespace {
+
+// What a user would notice as lag, on a desktop machine in a release build.
+// Showing a fresh listing includes sorting and measuring all rows, the
+// budgets for that and for filtering depend on the keyring size (see
+// initTestCase_data()).
+const qint64 selectionBudgetMs = 50;
+
+// Selecting a key only shows the details of the loaded key, whatever the
+// size of the keyring. Most of this is Qt's selection handling.
+const quint64 selectionAllocationBudget = 2000;
+
+const int keyListingTimeoutMs = 30000;
+
+// one gpg round trip, long enough to tell one from two
+const int decryptLatencyMs = 100;
+
+} // namespace
+
+// Stands in for Kate's main window. KTextEditor::MainWindow forwards its
+// calls to its parent by name, so these only need the right signatures.
+class TestMainWindowHost : public QObject {
+  Q_OBJECT
+
+public:
+  QWidget *toolview() const { return m_toolview; }
+
+  void setViews(const QList<KTextEditor::View *> &views_) { m_views = views_; }
+
+public slots:
+  QWidget *createToolView(KTextEditor::Plugin *plugin_,
+                          const QString &identifier_,
+                          KTextEditor::MainWindow::ToolViewPosition position_,
+                          const QIcon &icon_, const QString &text_) {
+    Q_UNUSED(plugin_)
+    Q_UNUSED(identifier_)
+    Q_UNUSED(position_)
+    Q_UNUSED(icon_)
+    Q_UNUSED(text_)
+    // owned by the view
+    m_toolview = new QWidget();
+    return m_toolview;
+  }
+
+  QList<KTextEditor::View *> views() { return m_views; }
+
+  KTextEditor::View *activeView() {
+    return m_views.isEmpty() ? nullptr : m_views.first();
+  }
+
+private:
+  QWidget *m_toolview = nullptr;
+  QList<KTextEditor::View *> m_views;
+};
+
+class KateGPGPluginViewTest : public QObject {
+  Q_OBJECT
+
+private slots:
+  void initTestCase_data();
+  void initTestCase();
+  void cleanupTestCase();
+  void init();
+  void cleanup();
+
+  void keysShownWithinBudget();
+  void filtersWithinBudget();
+  void searchPatternWithinBudget();
+  void selectionWithinBudget();
+  void workerOpsCountForTheAction();
+  void decryptRunsOneOperation();
+
+private:
+  QTemporaryDir m_settingsDir;
+  TestMainWindowHost m_host;
+  std::unique_ptr<KTextEditor::MainWindow> m_mainWindow;
+  std::unique_ptr<GPGFakeBackend> m_backend;
+  std::unique_ptr<KateGPGPluginView> m_view;
+  // from creating the view until its keys are shown
+  quint64 m_keysShownAllocations = 0;
+
+  template <class T> T *widget(const char *objectName_) const {
+    return m_host.toolview()->findChild<T *>(QString(objectName_));
+  }
+
+  static int numOps(const char *action_, GPGEngineOp op_) {
+    return GPGEngineStats::counts(action_).ops[int(op_)];
+  }
+};
+
+void KateGPGPluginViewTest::initTestCase_data() {
+  // every test runs once per keyring size
+  QTest::addColumn<int>("numKeys");
+  QTest::addColumn<qint64>("keysShownBudgetMs");
+  QTest::addColumn<qint64>("viewStateBudgetMs");
+
+  QTest::newRow("1k keys") << 1000 << qint64(1000) << qint64(100);
+  QTest::newRow("10k keys") << 10000 << qint64(1000) << qint64(100);
+  QTest::newRow("100k keys") << 100000 << qint64(5000) << qint64(500);
+}
+
+void KateGPGPluginViewTest::initTestCase() {
+  // neither the user's settings nor the user's key cache
+  QStandardPaths::setTestModeEnabled(true);
+  QVERIFY(m_settingsDir.isValid());
+  QSettings::setPath(QSettings::NativeFormat, QSettings::UserScope,
+                     m_settingsDir.path());
+  m_mainWindow.reset(new KTextEditor::MainWindow(&m_host));
+}
+
+void KateGPGPluginViewTest::cleanupTestCase() {
+  qInfo("gpg operations per action of the last test\n%s",
+        qPrintable(GPGEngineStats::summary()));
+}
+
+void KateGPGPluginViewTest::init() {
+  // every test starts with the default filters
+  QSettings("kate_gpg_plugin_settings").clear();
+  GPGEngineStats::reset();
+  QFETCH_GLOBAL(int, numKeys);
+  m_backend.reset(new GPGFakeBackend(numKeys));
+  // includes making up the keyring in the fake
+  const GPGAllocationCounter allocations;
+  m_view.reset(
+      new KateGPGPluginView(nullptr, m_mainWindow.get(), m_backend.get()));
+  QVERIFY(m_host.toolview());
+  QTRY_VERIFY_WITH_TIMEOUT(m_view->timings().keysShownMs >= 0,
+                           keyListingTimeoutMs);
+  m_keysShownAllocations = allocations.numAllocations();
+  QVERIFY(widget<QTableWidget>("keyTable")->rowCount() > 0);
+  // one listing in the background, no recent recipients to look up
+  QCOMPARE(numOps("key reload", GPGEngineOp::KeyListing), 1);
+  QCOMPARE(GPGEngineStats::counts("key reload").total(), 1);
+  QCOMPARE(GPGEngineStats::counts("key listing").total(), 0);
+  QCOMPARE(GPGEngineStats::counts("view state update").total(), 0);
+  QCOMPARE(GPGEngineStats::numBudgetViolations(), 0);
+}
+
+void KateGPGPluginViewTest::cleanup() {
+  m_view.reset();
+  m_backend.reset();
+}
+
+void KateGPGPluginViewTest::keysShownWithinBudget() {
+  QFETCH_GLOBAL(int, numKeys);
+  QFETCH_GLOBAL(qint64, keysShownBudgetMs);
+  qInfo("showing %d keys: %llu allocations, %.1f per key, peak RSS %lld KiB",
+        numKeys, m_keysShownAllocations,
+        double(m_keysShownAllocations) / numKeys,
+        GPGAllocationCounter::peakRssKiB());
+  const qint64 ms = m_view->timings().keysShownMs;
+  QVERIFY2(ms <= keysShownBudgetMs,
+           qPrintable(QString("showing %1 keys took %2 ms, budget %3 ms")
+                          .arg(numKeys)
+                          .arg(ms)
+                          .arg(keysShownBudgetMs)));
+}
+
+void KateGPGPluginViewTest::filtersWithinBudget() {
+  QCheckBox *hideExpired = widget<QCheckBox>("hideExpiredKeysCheckbox");
+  QCheckBox *onlyPrivate = widget<QCheckBox>("showOnlyPrivateKeysCheckbox");
+  QVERIFY(hideExpired && onlyPrivate);
+  const int numRows = widget<QTableWidget>("keyTable")->rowCount();
+  const quint64 numUpdates = m_view->numViewStateUpdates();
+  const GPGAllocationCounter allocations;
+  // both toggles land in one update
+  hideExpired->setChecked(!hideExpired->isChecked());
+  onlyPrivate->setChecked(!onlyPrivate->isChecked());
+  QTRY_COMPARE(m_view->numViewStateUpdates(), numUpdates + 1);
+  qInfo("applying the filters: %llu allocations",
+        allocations.numAllocations());
+  QVERIFY(widget<QTableWidget>("keyTable")->rowCount() != numRows);
+  QFETCH_GLOBAL(qint64, viewStateBudgetMs);
+  const qint64 ms = m_view->timings().viewStateMs;
+  QVERIFY2(ms <= viewStateBudgetMs,
+           qPrintable(QString("applying the filters took %1 ms, budget %2 ms")
+                          .arg(ms)
+                          .arg(viewStateBudgetMs)));
+  // only the loaded keys are filtered
+  QCOMPARE(GPGEngineStats::counts("view state update").total(), 0);
+  QCOMPARE(GPGEngineStats::counts("key reload").total(), 1);
+  QCOMPARE(GPGEngineStats::numBudgetViolations(), 0);
+}
+
+void KateGPGPluginViewTest::searchPatternWithinBudget() {
+  QLineEdit *filter = widget<QLineEdit>("keyFilterLineEdit");
+  QVERIFY(filter);
+  QFETCH_GLOBAL(qint64, viewStateBudgetMs);
+  // typing "user1" character by character, one update per character
+  const QString pattern("user1");
+  for (auto i = 1; i <= pattern.size(); ++i) {
+    const quint64 numUpdates = m_view->numViewStateUpdates();
+    filter->setText(pattern.left(i));
+    QTRY_COMPARE(m_view->numViewStateUpdates(), numUpdates + 1);
+    const qint64 ms = m_view->timings().viewStateMs;
+    QVERIFY2(ms <= viewStateBudgetMs,
+             qPrintable(QString("filtering by \"%1\" took %2 ms, budget %3 ms")
+                            .arg(pattern.left(i))
+                            .arg(ms)
+                            .arg(viewStateBudgetMs)));
+  }
+  QVERIFY(widget<QTableWidget>("keyTable")->rowCount() > 0);
+  QCOMPARE(GPGEngineStats::counts("view state update").total(), 0);
+  QCOMPARE(GPGEngineStats::counts("key reload").total(), 1);
+  QCOMPARE(GPGEngineStats::numBudgetViolations(), 0);
+}
+
+void KateGPGPluginViewTest::selectionWithinBudget() {
+  QTableWidget *table = widget<QTableWidget>("keyTable");
+  QVERIFY(table->rowCount() > 100);
+  for (auto row : {1, 50, 100}) {
+    const GPGAllocationCounter allocations;
+    table->selectRow(row);
+    const quint64 numAllocations = allocations.numAllocations();
+    QVERIFY2(numAllocations <= selectionAllocationBudget,
+             qPrintable(QString("selecting row %1 allocated %2 times, "
+                                "budget %3")
+                            .arg(row)
+                            .arg(numAllocations)
+                            .arg(selectionAllocationBudget)));
+    const qint64 ms = m_view->timings().selectionMs;
+    QVERIFY(ms >= 0);
+    QVERIFY2(ms <= selectionBudgetMs,
+             qPrintable(QString("selecting row %1 took %2 ms, budget %3 ms")
+                            .arg(row)
+                            .arg(ms)
+                            .arg(selectionBudgetMs)));
+  }
+  // the details come from the listing
+  QCOMPARE(GPGEngineStats::counts("key selection").total(), 0);
+  QCOMPARE(GPGEngineStats::numBudgetViolations(), 0);
+}
+
+void KateGPGPluginViewTest::workerOpsCountForTheAction() {
+  GPGEngineStats::reset();
+  GPGKeyLoader loader(m_backend.get());
+  QTest::ignoreMessage(
+      QtWarningMsg,
+      "kate-gpg-plugin: \"list keys\" ran more than 0 gpg operations");
+  {
+    GPGEngineStats::ActionScope scope("list keys", 0);
+    loader.start();
+  }
+  // the listing runs on a pool thread after the action has returned and
+  // still counts for it
+  QTRY_VERIFY_WITH_TIMEOUT(!loader.isRunning(), keyListingTimeoutMs);
+  QCOMPARE(numOps("list keys", GPGEngineOp::KeyListing), 1);
+  QCOMPARE(GPGEngineStats::counts(QString()).total(), 0);
+  QCOMPARE(GPGEngineStats::numBudgetViolations(), 1);
+}
+
+void KateGPGPluginViewTest::decryptRunsOneOperation() {
+  // key 1 has no private key, key 10 has one and is not expired
+  const QString publicKey = GPGFakeBackend::makeKey(1).fingerPrint();
+  const QString secretKey = GPGFakeBackend::makeKey(10).fingerPrint();
+  const QString plainText("secret text\n");
+  const GPGOperationResult encrypted = m_backend->encryptStringToRecipients(
+      plainText, QStringList() << publicKey << secretKey);
+  QVERIFY(encrypted.decryptionSuccess);
+
+  std::unique_ptr<KTextEditor::Document> document(
+      KTextEditor::Editor::instance()->createDocument(nullptr));
+  document->setText(encrypted.resultString);
+  // deleted along with the document
+  m_host.setViews({document->createView(nullptr)});
+  m_backend->setLatency(decryptLatencyMs);
+  GPGEngineStats::reset();
+  QElapsedTimer timer;
+  timer.start();
+  QVERIFY(QMetaObject::invokeMethod(m_view.get(), "decryptButtonPressed"));
+  const qint64 ms = timer.elapsed();
+  m_host.setViews({});
+
+  QCOMPARE(document->text(), plainText);
+  // the recipients come from the message's packets, gpg is only started
+  // for the decryption itself
+  QCOMPARE(numOps("decrypt", GPGEngineOp::Decrypt), 1);
+  QCOMPARE(GPGEngineStats::counts("decrypt").total(), 1);
+  QCOMPARE(GPGEngineStats::numBudgetViolations(), 0);
+  QVERIFY2(ms < 2 * decryptLatencyMs,
+           qPrintable(QString("decrypting took %1 ms, one gpg run is %2 ms")
+                          .arg(ms)
+                          .arg(decryptLatencyMs)));
+  QTableWidget *table = widget<QTableWidget>("keyTable");
+  const QModelIndexList selectedRows = table->selectionModel()->selectedRows();
+  QCOMPARE(selectedRows.size(), 1);
+  QCOMPARE(table->item(selectedRows.first().row(), 0)->text(), secretKey);
+}
+
+QTEST_MAIN(KateGPGPluginViewTest)
+
+#include "KateGPGPluginViewTest.moc"